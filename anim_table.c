@@ -0,0 +1,227 @@
+//
+// anim_table
+//
+// LXD Research & Display
+//
+// Canned animations for lcdPlay(); see anim_table.h. Generated by
+// host/anim_gen.c (make -C host anim): edit the scripts there, not this.
+//
+
+#include "anim_table.h"
+
+
+// animChangeover - 87
+static const lcdAnimFrame frames0[] =
+{
+    { 1200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+    } },
+    { 0, 0x06, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0xfe, 0x0e, 0x00, 0x00, 0x00, 0x00 },   // "  87  "
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00 },   // "------"
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    } },
+};
+
+
+// animChangeover - 100LL
+static const lcdAnimFrame frames1[] =
+{
+    { 1200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+    } },
+    { 0, 0x06, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x0c, 0x7e, 0x7e, 0x70, 0x70, 0x00, 0x00 },   // " 100LL"
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00 },   // "------"
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    } },
+};
+
+
+// animChangeover - JET A
+static const lcdAnimFrame frames2[] =
+{
+    { 1200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xfe, 0xe0, 0x00 },   // "888.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+        { 0xfe, 0xff, 0xff, 0xff, 0x07, 0x00, 0x00, 0x00 },   // "8.,8.,8.,8"
+    } },
+    { 0, 0x06, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x1c, 0xf2, 0xf0, 0x00, 0xee, 0x00, 0x00 },   // " JET A"
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00 },   // "------"
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    } },
+};
+
+
+// animList - 87
+static const lcdAnimFrame frames3[] =
+{
+    { 0, 0x30, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+    } },
+};
+
+
+// animList - 100LL
+static const lcdAnimFrame frames4[] =
+{
+    { 0, 0x28, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+    } },
+};
+
+
+// animList - JET A
+static const lcdAnimFrame frames5[] =
+{
+    { 0, 0x18, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+        { 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00 },   // "----"
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    } },
+};
+
+
+// animLampTest
+static const lcdAnimFrame frames6[] =
+{
+    { 500, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },   // 0xff
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },   // 0xff
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },   // 0xff
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },   // 0xff
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },   // 0xff
+    } },
+    { 250, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },   // 0x01
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },   // 0x01
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },   // 0x01
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },   // 0x01
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },   // 0x01
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02 },   // 0x02
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02 },   // 0x02
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02 },   // 0x02
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02 },   // 0x02
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02 },   // 0x02
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 0x04
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 0x04
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 0x04
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 0x04
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 0x04
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08 },   // 0x08
+        { 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08 },   // 0x08
+        { 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08 },   // 0x08
+        { 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08 },   // 0x08
+        { 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08 },   // 0x08
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },   // 0x10
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },   // 0x10
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },   // 0x10
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },   // 0x10
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },   // 0x10
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },   // 0x20
+        { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },   // 0x20
+        { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },   // 0x20
+        { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },   // 0x20
+        { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },   // 0x20
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40 },   // 0x40
+        { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40 },   // 0x40
+        { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40 },   // 0x40
+        { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40 },   // 0x40
+        { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40 },   // 0x40
+    } },
+    { 200, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // 0x80
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // 0x80
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // 0x80
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // 0x80
+        { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // 0x80
+    } },
+    { 0, 0x3e, {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // 0x00
+    } },
+};
+
+
+const lcdAnim animChangeover[] =
+{
+    { frames0, 2 },   // 87
+    { frames1, 2 },   // 100LL
+    { frames2, 2 },   // JET A
+};
+const lcdAnim animList[] =
+{
+    { frames3, 1 },   // 87
+    { frames4, 1 },   // 100LL
+    { frames5, 1 },   // JET A
+};
+const lcdAnim animLampTest = { frames6, 11 };
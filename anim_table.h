@@ -0,0 +1,25 @@
+#ifndef _ANIM_TABLE_H_
+#define _ANIM_TABLE_H_
+
+// anim_table
+//
+// Canned animations for lcdPlay() (nxp_lcd_driver.h): raw segment frames
+// and their times, as const data in flash. anim_table.c is generated by
+// host/anim_gen.c, which encodes its scripts with the driver's own
+// encoders; after changing a script (or the glyphs, or the glass),
+// regenerate it with "make -C host anim".
+
+#include "nxp_lcd_driver.h"
+
+// Grade changeover, per grade (as demo.c's fuelGrade): all segments on,
+// then the grade's name over "------" on the large display
+extern const lcdAnim animChangeover[3];
+
+// Per grade: "----" on the other grades' price LCDs (S1..S3)
+extern const lcdAnim animList[3];
+
+// Lamp test (lcdLampTest()): all segments on, all off, then each
+// segment bit in turn, then off
+extern const lcdAnim animLampTest;
+
+#endif
@@ -0,0 +1,165 @@
+//
+// cpu_load
+//
+// LXD Research & Display
+//
+// Idle loop and CPU utilization accounting; see cpu_load.h.
+//
+// Main-line code keeps the class it's running under, and the core timer
+// count at the last switch. The interrupts add their own time to their
+// class, and to irqTicks; the next switch deducts whatever irqTicks has
+// grown by from the main-line class, so each tick lands in one class.
+//
+
+#include <stdint.h>
+
+#include "cpu_load.h"
+#include "sched.h"
+
+#if defined __PIC32MX__
+  #include <p32xxxx.h>
+#else
+  #include <time.h>
+  #include "p32_utils.h"
+  #include "lcd_bus_host.h"
+#endif
+
+
+// cpuIdle
+//
+// WAIT: the core sleeps until an interrupt, whose handler runs before
+// WAIT returns. At the latest that's the next scheduler tick, so no task
+// is late by more than it would be spinning. On the host, let a little
+// virtual time pass instead.
+//
+void cpuIdle(void)
+{
+    CPU_VAR(was)
+
+    CPU_ENTER(was, CPU_IDLE);
+#if defined __PIC32MX__
+    __asm__ volatile("wait");
+#else
+    delay_us(50);
+#endif
+    CPU_LEAVE(was);
+}
+
+
+#ifdef CPU_LOAD_STATS
+
+volatile cpuLoadStats cpuLoad;
+
+static volatile uint32_t irqTicks;   // All interrupt time; interrupts only
+static uint32_t irqSeen;             // irqTicks already deducted
+static uint32_t since;               // cpuNow() at the last switch
+static int      running = CPU_APP;   // Main-line class
+static uint32_t last[CPU_CLASSES];   // cpuLoad.ticks at the last window
+
+
+// cpuNow
+//
+// Core timer count. The host build stands in its monotonic clock (the
+// time actually spent) plus the virtual clock (the time waited), scaled
+// to the same rate.
+//
+uint32_t cpuNow(void)
+{
+#if defined __PIC32MX__
+    return _CP0_GET_COUNT();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec + hostClockNs)
+                      / (1000000000ULL / CPU_LOAD_TICK_HZ));
+#endif
+}
+
+
+// cpuSwitch
+//
+// The count and irqTicks are read until no interrupt finished in
+// between, so an interrupt's time is either all before 'now' (and
+// deducted here) or all after (and deducted next time).
+//
+int cpuSwitch(int cls)
+{
+    uint32_t now, irq;
+    int was = running;
+
+    do
+    {
+        irq = irqTicks;
+        now = cpuNow();
+    } while(irq != irqTicks);
+
+    cpuLoad.ticks[running] += (now - since) - (irq - irqSeen);
+    since = now;
+    irqSeen = irq;
+    running = cls;
+    return was;
+}
+
+
+// cpuIrq
+//
+// Interrupts of different priorities may nest, so the adds are atomic
+// (LL/SC on the PIC32).
+//
+void cpuIrq(int cls, uint32_t start)
+{
+    uint32_t t = cpuNow() - start;
+
+    __sync_fetch_and_add(&cpuLoad.ticks[cls], t);
+    __sync_fetch_and_add(&irqTicks, t);
+}
+
+
+// The window task: bring the main-line count up to date, then turn the
+// ticks each class took since the last window into shares of the total.
+//
+static void cpuLoadTask(void *ctx)
+{
+    uint32_t d[CPU_CLASSES];
+    uint32_t sum = 0;
+    int c;
+
+    (void)ctx;
+    cpuSwitch(running);
+    for(c = 0; c < CPU_CLASSES; c++)
+    {
+        uint32_t t = cpuLoad.ticks[c];
+
+        d[c] = t - last[c];
+        last[c] = t;
+        sum += d[c];
+    }
+    if(sum == 0)
+        return;
+
+    for(c = 0; c < CPU_CLASSES; c++)
+    {
+        cpuLoad.permille[c] = (uint16_t)((uint64_t)d[c] * 1000 / sum);
+        cpuLoad.total[c] += d[c];
+    }
+    cpuLoad.busy = 1000 - cpuLoad.permille[CPU_IDLE];
+    cpuLoad.windows++;
+}
+
+
+// cpuLoadStart
+//
+// Accounting starts from now, as CPU_APP.
+//
+void cpuLoadStart(void)
+{
+    int c;
+
+    cpuSwitch(CPU_APP);
+    for(c = 0; c < CPU_CLASSES; c++)
+        last[c] = cpuLoad.ticks[c];
+    schedTimerStart(cpuLoadTask, 0, CPU_LOAD_MS, CPU_LOAD_MS);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _CPU_LOAD_H_
+#define _CPU_LOAD_H_
+
+// cpu_load
+//
+// Idle loop and CPU utilization accounting. When the scheduler has
+// nothing due, the main loop calls cpuIdle(), which WAITs (the MIPS
+// WAIT instruction: the core stops until the next interrupt, at the
+// latest the 1ms tick).
+//
+// Every core timer tick is charged to one class: the one main-line code
+// is running under (cpuSwitch(); idle while WAITing), less the time the
+// interrupts took, which is charged to the interrupt's class. A
+// scheduler task (cpuLoadStart()) turns that into percentages every
+// CPU_LOAD_MS, in cpuLoad, which can be read at runtime (debugger
+// watch, or dumped by the application) - the headroom left for more
+// displays, pumps or protocol work.
+//
+// The accounting is enabled by defining CPU_LOAD_STATS (product_config.h).
+// Otherwise the CPU_xxx macros expand to nothing and cpuLoad doesn't
+// exist; cpuIdle() still WAITs.
+//
+// On the host, busy time is host CPU time and idle the virtual time
+// waited, so the split there is only a rough guide (a PC is many times
+// a PIC32).
+
+#include <stdint.h>
+
+#include "product_config.h"
+
+// Classes
+#define CPU_IDLE      0   // WAITing for an interrupt
+#define CPU_APP       1   // Main loop and scheduler tasks (the default)
+#define CPU_DISPLAY   2   // LCD driver: encoding, diffing, queueing frames
+#define CPU_BUS       3   // I2C interrupts
+#define CPU_IRQ       4   // Other interrupts (tick, pulser)
+#define CPU_CLASSES   5
+
+#define CPU_LOAD_MS       1000           // Reporting window
+#define CPU_LOAD_TICK_HZ  (CPU_HZ / 2)   // Core timer rate
+
+
+// Wait for an interrupt (idle). Call from the main loop when there's
+// nothing to do.
+void cpuIdle(void);
+
+
+#ifdef CPU_LOAD_STATS
+
+typedef struct
+{
+    uint32_t ticks[CPU_CLASSES];      // Core timer ticks, free running (wrap)
+    uint16_t permille[CPU_CLASSES];   // Share of the last window, in tenths of a %
+    uint16_t busy;                    // All but idle, in the last window (tenths of a %)
+    uint32_t windows;                 // Windows completed
+    uint64_t total[CPU_CLASSES];      // Ticks over all the completed windows
+} cpuLoadStats;
+
+extern volatile cpuLoadStats cpuLoad;
+
+// Start the accounting, and the task that fills in cpuLoad.
+void cpuLoadStart(void);
+
+// Charge the time since the last switch to the class running until now,
+// and carry on as 'cls'. Returns the class that was running, for the
+// switch back. Main-line code only.
+int cpuSwitch(int cls);
+
+// Charge an interrupt's time (from 'start', a cpuNow()) to 'cls'. Call at
+// the end of the handler. (A nested interrupt's time is charged to both.)
+void cpuIrq(int cls, uint32_t start);
+
+uint32_t cpuNow(void);    // Core timer count (the host stands in its own)
+
+#define CPU_VAR(v)               int v;
+#define CPU_ENTER(v, cls)        ((v) = cpuSwitch(cls))
+#define CPU_LEAVE(v)             ((void)cpuSwitch(v))
+#define CPU_IRQ_VAR(v)           uint32_t v;
+#define CPU_IRQ_ENTER(v)         ((v) = cpuNow())
+#define CPU_IRQ_LEAVE(cls, v)    cpuIrq(cls, v)
+
+#else
+
+#define CPU_VAR(v)
+#define CPU_ENTER(v, cls)        ((void)0)
+#define CPU_LEAVE(v)             ((void)0)
+#define CPU_IRQ_VAR(v)
+#define CPU_IRQ_ENTER(v)         ((void)0)
+#define CPU_IRQ_LEAVE(cls, v)    ((void)0)
+
+#endif
+
+#endif
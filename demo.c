@@ -0,0 +1,260 @@
+//
+// demo
+//
+// LXD Research & Display
+//
+// Gilbarco LCD demo, run as a state machine task under sched.c. Each
+// call does one step and arms a one-shot timer for the next, so the
+// pauses of the changeover sequence no longer hold up the CPU; the
+// price flash is left to the controllers' blink engine (lcdBlink(disp)),
+// and its constant frames (all segments on, the grade name, the dashes)
+// are canned animations (anim_table.h), played from flash by lcdPlay().
+// If the i2c queue is full, a step is retried a tick later, except in
+// the fill-up loop, where the frame is dropped and the next tick's
+// value goes instead. With coalescing on (LCD_REFRESH_HZ), the driver
+// only puts the latest of those frames on the bus, at that rate.
+//
+// With POS_LINK, the site controller can change the prices and pick the
+// grade (pos_link.h): a new grade changes over at the next fill-up tick,
+// and a new price shows from the next changeover (the sale in progress
+// keeps its price).
+//
+// With FLOW_PULSER, the volume comes from the flow meter: each fill-up
+// tick takes a snapshot and shows it, so the display runs at its own
+// rate however fast the pulser is, and the count carries on while a
+// frame is on the bus.
+//
+
+#include <stdint.h>
+
+#include "demo.h"
+#include "sched.h"
+#include "nxp_lcd_driver.h"
+#include "dispense.h"
+#include "anim_table.h"
+#ifdef FLOW_PULSER
+  #include "flow.h"
+#endif
+#ifdef POS_LINK
+  #include "pos_link.h"
+#endif
+
+
+#define DEMO_FILL_MS    1      // Fill-up tick
+#define DEMO_HOLD_MS    1200   // All-on & price list pauses
+#define DEMO_FLASH_MS   2000   // Price flash (2Hz blink: 4 flashes)
+
+// Start-up pattern: all numbers, decimals, commas
+static const struct
+{
+    uint8_t     lcd;
+    const char *s;
+} intro[] =
+{
+    { LCD_L1, "111111," },
+    { LCD_L1, "11111,1" },
+    { LCD_L1, "1111,11" },
+    { LCD_L1, "111,111" },
+    { LCD_L1, "11,1111" },
+    { LCD_S1, "7777," },
+    { LCD_S1, "777,7" },
+    { LCD_S1, "77,77" },
+    { LCD_S1, "7,777" },
+    { LCD_S1, ",7777" },
+    { LCD_S1, "3.652" },
+    { LCD_S2, "3.821" },
+    { LCD_S3, "4.027" },
+};
+
+// Three grades / types of fuel: 87, 100LL, JET A (their names are in the
+// changeover animations)
+static uint32_t pricePerGallon[] =   // Tenths of a cent per gallon
+{
+    3652,   // mogas 87
+    3821,   // 100LL
+    4027    // JET-A
+};
+
+static uint8_t  state;
+static uint8_t  step;         // Intro line
+static uint32_t ticks;        // Fill-up ticks
+static int      fuelGrade = 2;
+static int      gradeReq = -1;  // Grade to change over to, from the POS; -1 if none
+static dispenseSale sale;     // Volume in milli-gallons, amount in cents
+static nxpDisplay *disp;      // The display set it runs on
+#ifdef FLOW_PULSER
+static uint32_t flowVolume;   // Meter volume already added to the sale
+#endif
+
+static void demoTask(void *ctx);
+
+
+void demoStart(nxpDisplay *d)
+{
+    disp = d;
+    state = DEMO_WAIT_LCD;
+    schedTimerStart(demoTask, 0, 0, 0);
+}
+
+
+int demoState(void)
+{
+    return state;
+}
+
+
+uint32_t demoTicks(void)
+{
+    return ticks;
+}
+
+
+// demoTask
+//
+// One step of the demo; arms the timer for the next.
+//
+static void demoTask(void *ctx)
+{
+#ifdef FLOW_PULSER
+    flowSnapshot flow;
+#endif
+    char tempStr[16];
+    uint32_t wait = 1;
+    int i;
+
+    switch(state)
+    {
+        case DEMO_WAIT_LCD:
+            if(!nxpReady(disp))
+            {
+                wait = 10;
+                break;
+            }
+            state = DEMO_INTRO;
+            step = 0;
+            wait = 0;
+            break;
+
+        case DEMO_INTRO:
+            if(lcdWrite(disp, intro[step].lcd, (char *)intro[step].s))
+                break;      // Queue full; try again
+            if(++step >= sizeof(intro) / sizeof(intro[0]))
+            {
+                dispenseStart(&sale, 200000, pricePerGallon[fuelGrade]);
+                state = DEMO_COUNT;
+            }
+            break;
+
+        case DEMO_COUNT:
+            // Put amount and volume up as counters; from here on, each
+            // tick only redraws the digits that roll over
+            lcdBeginFrame(disp);
+            lcdCounterStart(disp, LCD_L1, sale.amount, 2);
+            lcdCounterStart(disp, LCD_L2, sale.volume, 3);
+            if(lcdCommitFrame(disp, 0))
+                break;
+#ifdef FLOW_PULSER
+            flowRead(&flow);
+            flowVolume = flow.volume;   // The sale starts from here
+#endif
+            state = DEMO_FILL;
+            break;
+
+        case DEMO_FILL:
+            // Pumping fuel: Increment gallons and price, and update big
+            // display. Both lines go as one frame, so price & volume
+            // change together.
+            ticks++;
+#ifdef FLOW_PULSER
+            flowRead(&flow);
+            dispenseAdd(&sale, flow.volume - flowVolume);
+            flowVolume = flow.volume;
+#else
+            dispenseAdd(&sale, 9);  // .009 gal will make LS digit go thru all digits (backwards).
+#endif
+            lcdBeginFrame(disp);
+            lcdCounterSet(disp, LCD_L1, sale.amount);
+            lcdCounterSet(disp, LCD_L2, sale.volume);
+            lcdCommitFrame(disp, 0);
+            wait = DEMO_FILL_MS;
+
+            // When we hit 200g, cycle to the next fuel grade (or go to
+            // the one the POS picked).
+            if(sale.volume > 200000 || gradeReq >= 0)
+            {
+                // Restart gallons at a high (non-zero) value, so we see lots of
+                // digits, and it won't take long to reset to a new fuel grade.
+                if(gradeReq >= 0)
+                    fuelGrade = gradeReq;
+                else if(++fuelGrade >= 3)
+                    fuelGrade = 0;          // Cycle fuel grade
+                gradeReq = -1;
+                dispenseStart(&sale, 180000, pricePerGallon[fuelGrade]);  // Reset gallons
+                state = DEMO_ALL_ON;
+            }
+            break;
+
+        case DEMO_ALL_ON:
+            // Displays all on, then the fuel type/name; the player
+            // calls back (DEMO_PRICES) as the name goes up
+            if(lcdPlay(disp, &animChangeover[fuelGrade], demoTask, ctx))
+                break;
+            state = DEMO_PRICES;
+            return;
+
+        case DEMO_PRICES:
+            // Show all three prices
+            lcdBeginFrame(disp);
+            for(i=0; i<3; i++)
+            {
+                fmtFixed(tempStr, pricePerGallon[i], 5, 3);
+                lcdWrite(disp, LCD_S1 + i, tempStr);
+            }
+            if(lcdCommitFrame(disp, 0))
+                break;
+            state = DEMO_FLASH;
+            wait = DEMO_HOLD_MS;
+            break;
+
+        case DEMO_FLASH:
+            // Flash the price for this fuel grade (the controllers do
+            // the flashing)
+            if(lcdBlink(disp, LCD_S1 + fuelGrade, LCD_BLINK_2HZ))
+                break;
+            state = DEMO_LIST;
+            wait = DEMO_FLASH_MS;
+            break;
+
+        case DEMO_LIST:
+            // Stop the flashing, and clear small LCDs, except the chosen
+            // grade's price
+            if(lcdBlink(disp, LCD_S1 + fuelGrade, LCD_BLINK_OFF))
+                break;
+            if(lcdPlay(disp, &animList[fuelGrade], 0, 0))
+                break;
+            state = DEMO_COUNT;
+            break;
+    }
+
+    schedTimerStart(demoTask, ctx, wait, 0);
+}
+
+
+#ifdef POS_LINK
+// POS commands (see pos_link.h)
+
+int posSetPrice(int grade, uint32_t price)
+{
+    if(grade < 0 || grade >= 3 || price == 0 || price > 99999) return POS_ERR_ARG;
+    pricePerGallon[grade] = price;
+    return POS_OK;
+}
+
+
+int posSelectGrade(int grade)
+{
+    if(grade < 0 || grade >= 3) return POS_ERR_ARG;
+    gradeReq = grade;
+    return POS_OK;
+}
+#endif
@@ -0,0 +1,32 @@
+#ifndef _DEMO_H_
+#define _DEMO_H_
+
+// demo
+//
+// The Gilbarco LCD demo (formerly the body of main()), as a scheduler
+// task: once the displays are up, a start-up pattern, then the
+// "fill-up" loop, with a grade changeover sequence each time the volume
+// passes 200 gallons. See demo.c.
+
+#include <stdint.h>
+
+#include "nxp_lcd_driver.h"
+
+// Demo task states
+#define DEMO_WAIT_LCD   0   // Waiting for nxpInit() to finish
+#define DEMO_INTRO      1   // Start-up pattern: digits, commas, prices
+#define DEMO_FILL       2   // Pumping fuel
+#define DEMO_ALL_ON     3   // Changeover: all segments on
+#define DEMO_PRICES     4   // Changeover: grade name & all prices
+#define DEMO_FLASH      5   // Changeover: flash the new grade's price
+#define DEMO_LIST       6   // Changeover: "----" list & the chosen price
+#define DEMO_COUNT      7   // Put amount & volume up as counters
+
+// Start the demo task on display set d (after schedInit() and nxpInit()).
+void demoStart(nxpDisplay *d);
+
+// Current DEMO_xxx state, and fill-up ticks run so far.
+int demoState(void);
+uint32_t demoTicks(void);
+
+#endif
@@ -0,0 +1,97 @@
+//
+// dispense
+//
+// LXD Research & Display
+//
+// Fixed-point sale arithmetic and formatting for the pump displays.
+// Replaces the soft-float double math and sprintf("%6.2f") that the
+// fill-up loop used to run on every tick. See dispense.h for the units
+// and rounding policy.
+//
+
+#include <stdint.h>
+
+#include "dispense.h"
+
+
+// dispenseStart - Start a sale
+//
+void dispenseStart(dispenseSale *sale, uint32_t volume, uint32_t unitPrice)
+{
+    sale->volume = volume;
+    sale->unitPrice = unitPrice;
+    sale->amount = dispenseAmount(volume, unitPrice);
+}
+
+
+// dispenseAdd - Add volume to a sale
+//
+void dispenseAdd(dispenseSale *sale, uint32_t deltaVolume)
+{
+    sale->volume += deltaVolume;
+    sale->amount = dispenseAmount(sale->volume, sale->unitPrice);
+}
+
+
+// dispenseAmount
+//
+// amount (cents) = volume (mgal) * unitPrice (0.1 cent) / 10000, rounded.
+//
+// The full product overflows 32 bits at ordinary sale sizes (1000 gal at
+// $4 is 4e9), so it's split into whole gallons and the milli-gallon
+// remainder. whole is the sale in tenths of a cent, so it fits for sales
+// up to $4,294,967; part fits at any price under $4,299:
+//
+//    whole = gallons * unitPrice          (tenths of a cent)
+//    part  = mgal_remainder * unitPrice   (tenths of a cent * 1000)
+//
+//    amount = whole/10 + ((whole%10)*1000 + part + 5000) / 10000
+//
+uint32_t dispenseAmount(uint32_t volume, uint32_t unitPrice)
+{
+    uint32_t whole = (volume / 1000) * unitPrice;
+    uint32_t part  = (volume % 1000) * unitPrice;
+
+    return whole / 10 + ((whole % 10) * 1000 + part + 5000) / 10000;
+}
+
+
+// fmtFixed
+//
+// Example: fmtFixed(buf, 80540, 6, 2) gives "805.40";
+//          fmtFixed(buf, 3652, 5, 3)  gives "3.652";
+//          fmtFixed(buf, 550, 6, 2)   gives "  5.50"
+//
+int fmtFixed(char *buf, uint32_t value, int width, int decimals)
+{
+    char digits[12];   // Reversed: 10 digits max, plus the point
+    int n = 0;
+    int len;
+
+    if(decimals < 0 || decimals > 9)   // Past a uint32_t's 10 digits
+    {
+        buf[0] = 0;
+        return 0;
+    }
+
+    // Generate digits least significant first, dropping the point in
+    // after 'decimals' of them. Keep going until the value runs out and
+    // there's at least one digit ahead of the point.
+    do
+    {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+        if(n == decimals)
+            digits[n++] = '.';
+    } while(value || n <= decimals + (decimals > 0));
+
+    // Pad, then copy the digits out in the right order
+    len = 0;
+    while(len < width - n)
+        buf[len++] = ' ';
+    while(n)
+        buf[len++] = digits[--n];
+    buf[len] = 0;
+
+    return len;
+}
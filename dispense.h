@@ -0,0 +1,48 @@
+#ifndef _DISPENSE_H_
+#define _DISPENSE_H_
+
+// dispense
+//
+// Fixed-point fuel sale arithmetic. The PIC32MX has no FPU, so all sale
+// values are kept as scaled integers:
+//
+//   Volume      milli-gallons      (200.009 gal  -> 200009)
+//   Unit price  tenths of a cent   ($3.652/gal   -> 3652)
+//   Amount      cents              ($805.40      -> 80540)
+//
+// Rounding policy: the amount is always recomputed from the total volume
+// (never accumulated per tick), and rounded half-up to the cent. So a
+// given volume and price always show the same amount, however the volume
+// was reached.
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t volume;      // Milli-gallons dispensed
+    uint32_t unitPrice;   // Tenths of a cent per gallon
+    uint32_t amount;      // Cents, rounded half-up
+} dispenseSale;
+
+
+// Start a sale at the given volume (normally 0) and unit price.
+void dispenseStart(dispenseSale *sale, uint32_t volume, uint32_t unitPrice);
+
+// Add milli-gallons to a sale, and update its amount.
+void dispenseAdd(dispenseSale *sale, uint32_t deltaVolume);
+
+// Amount in cents for a volume (milli-gallons) at a unit price (tenths
+// of a cent per gallon), rounded half-up. Good while whole gallons x
+// unitPrice stays under 2^32, i.e. for sales up to $4,294,967 (about
+// 1,070,000 gallons at $4), at prices under $4,299 a gallon.
+uint32_t dispenseAmount(uint32_t volume, uint32_t unitPrice);
+
+// Format a scaled integer as a fixed-point decimal string, without
+// printf or floating point: like sprintf("%<width>.<decimals>f") of
+// value / 10^decimals. Right justified, space padded to width (at
+// least); buf needs room for max(width, 11) chars plus the null.
+// decimals goes from 0 to 9; out of that range, buf is left empty.
+// Returns the string length.
+int fmtFixed(char *buf, uint32_t value, int width, int decimals);
+
+#endif
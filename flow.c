@@ -0,0 +1,132 @@
+//
+// flow
+//
+// LXD Research & Display
+//
+// Flow meter; see flow.h. The pulser interrupt (flowEdge()) does no
+// more than count the edge and keep its time. Everything else - volume,
+// rate, stall detection - is worked out in flowRead(), from main-line
+// code, as often as the display wants it.
+//
+// The interrupt hands the count and time of the latest edge to
+// flowRead() through a seqlock snapshot (spsc.h): the pair is always
+// read together, no interrupts are masked, and an edge never waits for
+// a reader.
+//
+
+#include <stdint.h>
+
+#include "flow.h"
+#include "pulser.h"
+#include "spsc.h"
+
+
+typedef struct
+{
+    uint32_t count;                    // Edges since flowInit()
+    uint32_t stamp;                    // Capture time of the last one
+} flowEdges;
+
+SPSC_SNAPSHOT(flowEdgeSnap, flowEdges)
+
+static flowEdgeSnap edges;             // Interrupt to flowRead()
+static uint32_t     isrCount;          // The interrupt's own count
+
+static uint32_t kFactor;               // Thousandths of a pulse per gallon
+static uint32_t tickHz;                // Pulser timer rate
+
+// Rate window: from the edge at its start to the latest edge
+static uint8_t  windowOpen;
+static uint32_t windowPulses;
+static uint32_t windowStamp;
+static uint32_t rate;                  // Milli-gallons per minute
+
+
+void flowInit(int pbClk, uint32_t k)
+{
+    flowEdges none = { 0, 0 };
+
+    isrCount = 0;
+    flowEdgeSnapWrite(&edges, &none);
+    windowOpen = 0;
+    windowPulses = 0;
+    rate = 0;
+    kFactor = k ? k : 1;
+    tickHz = pulserInit(pbClk);
+}
+
+
+int flowSetKFactor(uint32_t k)
+{
+    if(k == 0)
+        return 1;
+    kFactor = k;
+    return 0;
+}
+
+
+// flowEdge
+//
+// Called from the pulser interrupt, once per edge.
+//
+void flowEdge(uint32_t stamp)
+{
+    flowEdges e;
+
+    e.count = ++isrCount;
+    e.stamp = stamp;
+    flowEdgeSnapWrite(&edges, &e);
+}
+
+
+// flowRead
+//
+// The rate is pulses over time between edges (not per call), so it
+// doesn't jitter with the display's refresh: a window opens at an edge,
+// and once the latest edge is FLOW_RATE_MS or more past it, the rate is
+// worked out and the next window opens at that edge. A meter that's
+// gone quiet for FLOW_STALL_MS reads 0, and the next edge after that
+// opens a fresh window.
+//
+void flowRead(flowSnapshot *snap)
+{
+    flowEdges e;
+    uint32_t pulses, stamp, dt;
+    uint64_t mppm;   // Thousandths of a pulse per minute
+
+    flowEdgeSnapRead(&edges, &e);
+    pulses = e.count;
+    stamp = e.stamp;
+
+    if(pulses != windowPulses)
+    {
+        if(!windowOpen)
+        {
+            windowOpen = 1;
+            windowPulses = pulses;
+            windowStamp = stamp;
+        }
+        else
+        {
+            dt = stamp - windowStamp;
+            if(dt >= (uint64_t)tickHz * FLOW_RATE_MS / 1000)
+            {
+                mppm = (uint64_t)(pulses - windowPulses) * tickHz * 60000 / dt;
+                rate = (uint32_t)(mppm * 1000 / kFactor);
+                windowPulses = pulses;
+                windowStamp = stamp;
+            }
+        }
+    }
+    if(pulserNow() - stamp >= (uint64_t)tickHz * FLOW_STALL_MS / 1000)
+    {
+        rate = 0;
+        windowOpen = 0;
+        windowPulses = pulses;
+    }
+
+    snap->pulses = pulses;
+    snap->volume = (uint32_t)((uint64_t)pulses * 1000000 / kFactor);
+    snap->rate = rate;
+    snap->stamp = stamp;
+}
@@ -0,0 +1,43 @@
+#ifndef _FLOW_H_
+#define _FLOW_H_
+
+// flow
+//
+// Flow meter: counts pulser edges (pulser.h) and turns them into volume
+// and flow rate. The edges are counted in the pulser interrupt, which
+// runs above the I2C and tick interrupts, so no edge waits on the
+// display; the display side just takes a snapshot whenever it's ready
+// to show one (flowRead()), at its own rate.
+//
+// Units follow dispense.h: volume in milli-gallons, and rate in
+// milli-gallons per minute. The K-factor is the meter's pulses per
+// gallon, in thousandths (so a 100 pulse/gal meter is 100000).
+
+#include <stdint.h>
+
+#define FLOW_RATE_MS   250    // Shortest window the rate is measured over
+#define FLOW_STALL_MS  1000   // No edge for this long: flow has stopped (rate 0)
+
+typedef struct
+{
+    uint32_t pulses;     // Edges counted since flowInit()
+    uint32_t volume;     // Milli-gallons since flowInit()
+    uint32_t rate;       // Milli-gallons per minute; 0 when stopped
+    uint32_t stamp;      // Pulser time of the last edge (pulser.h ticks)
+} flowSnapshot;
+
+
+// Start counting, with the meter's K-factor (thousandths of a pulse per
+// gallon). Volume starts from zero.
+void flowInit(int peripheralBusClock, uint32_t kFactor);
+
+// Change the K-factor (meter calibration); the volume counted so far is
+// recomputed with it. Returns 1 if kFactor is 0.
+int flowSetKFactor(uint32_t kFactor);
+
+// Take a snapshot of the count, and the volume and rate it makes.
+// The pulse count and its edge time always come from the same edge.
+// Call from main-line code only.
+void flowRead(flowSnapshot *snap);
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef _GLASS_H_
+#define _GLASS_H_
+
+// glass
+//
+// Seven segment glass descriptors, and the one string encoder that works
+// from them. A descriptor says where each digit's segments, period and
+// comma are wired in the controller's segment bytes; glassEncode() turns
+// a display string into those bytes for any glass so described.
+//
+// glassEncode() is always inlined, and meant to be called with a pointer
+// to a static const descriptor: the compiler then folds the descriptor
+// into the code, and the result is as fast as a hand-written encoder for
+// that glass. A new glass is just a new descriptor.
+//
+// Which controller drives the glass, and so how its commands are
+// framed, is the driver's business (by LCD group), not the glass's.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "glyphs.h"
+
+#define GLASS_MAX_DIGITS  7     // Less than GLYPH_RING
+
+// Inlined into every caller, however big: it only folds down to the
+// glass's own encoder if it's inlined where the descriptor is known.
+// (gcc and C32 both take the attribute.)
+#define GLASS_INLINE  static inline __attribute__((always_inline))
+
+// Digits are numbered from the right (0 = right-most). Each digit's
+// segments a..g go to bits 1..7 of its segment byte, as in glyphs.h;
+// its period, if wired, is one more bit (usually bit 0 of the same
+// byte), and its comma a bit in the comma byte.
+typedef struct
+{
+    uint8_t digits;                     // Digit count
+    uint8_t nBytes;                     // Segment bytes wired (and written)
+    uint8_t commaByte;                  // Segment byte holding the commas
+    struct
+    {
+        uint8_t byte;                   // Segment byte for the digit
+        uint8_t period;                 // Period bit in that byte; 0 if none
+        uint8_t comma;                  // Comma bit in commaByte; 0 if none
+    } digit[GLASS_MAX_DIGITS];
+} glassDesc;
+
+
+// glyphScan
+//
+// Makes a single left-to-right pass over the string (no strlen),
+// with one glyphTable[] read per character. Since we don't know where
+// the string ends until we get there, the most recent glyphs are kept
+// in a small ring (glyphRing), indexed by glyph count; punctuation is
+// OR'd into the glyph before it. Slot 7 starts out as the blank "glyph"
+// ahead of the first, so a leading period still has somewhere to go.
+//
+#define GLYPH_RING 8   // Power of 2, and more than the widest display
+
+typedef struct
+{
+    uint8_t cell[GLYPH_RING];  // Segment code (+ period bit) per glyph
+    uint8_t commas;            // Bit per cell: comma after this glyph
+    int     count;             // Glyphs seen
+} glyphRing;
+
+GLASS_INLINE void glyphScan(const char *displayStr, glyphRing *r)
+{
+    const uint8_t *p = (const uint8_t *)displayStr;
+    uint8_t code;
+    int k = 0;
+
+    memset(r->cell, 0, sizeof(r->cell));
+    r->commas = 0;
+
+    while(*p)
+    {
+        code = glyphTable[*p++];
+        if(!(code & GLYPH_CLASS))           // A glyph
+        {
+            r->cell[k & (GLYPH_RING-1)] = code;
+            r->commas &= ~(1 << (k & (GLYPH_RING-1)));
+            k++;
+        }
+        else if(code == GLYPH_PERIOD)       // Period on the glyph before
+        {
+            r->cell[(k-1) & (GLYPH_RING-1)] |= 1;  // LS bit turns on the period
+        }
+        else if(code == GLYPH_COMMA)        // Comma on the glyph before
+        {
+            r->commas |= 1 << ((k-1) & (GLYPH_RING-1));
+        }
+        // else GLYPH_INVALID; skip it
+    }
+    r->count = k;
+}
+
+
+// glassDigit - One digit of glassEncode(): its segments and period into
+//              its segment byte, its comma (if any) into *commas
+//
+GLASS_INLINE void glassDigit(const glassDesc *glass, int pos, const glyphRing *r,
+                             uint8_t segmentByte[], uint8_t *commas)
+{
+    int g = (r->count - 1 - pos) & (GLYPH_RING-1);   // Ring index of the glyph there
+    uint8_t cell = r->cell[g];
+
+    segmentByte[glass->digit[pos].byte] |= (cell & 0xfe) | ((cell & 1) * glass->digit[pos].period);
+    *commas |= ((r->commas >> g) & 1) * glass->digit[pos].comma;
+}
+
+
+// glassEncode
+//
+// Given a string to display, prepare the segment bytes (glass->nBytes of
+// them) that will show it on the glass.
+//
+// The string is right justified on the display; characters that don't
+// fit fall off the left. A period or comma belongs to the digit on its
+// left (so "1.23" lights the period after the '1'), and only shows if
+// that digit has one wired.
+//
+// The digits are written out rather than looped over, so that with a
+// constant descriptor every field below is a constant, whatever the
+// compiler's unrolling: the unused digits drop out, and the period and
+// comma terms fold down to a mask, or to nothing. No branches on the
+// string, either.
+//
+// Returns 0 on success; Error code otherwise
+//
+GLASS_INLINE int glassEncode(const glassDesc *glass, const char *displayStr, uint8_t segmentByte[])
+{
+    glyphRing r;
+    uint8_t commas = 0;
+
+    glyphScan(displayStr, &r);
+    memset(segmentByte, 0, glass->nBytes);
+
+    if(glass->digits > 0) glassDigit(glass, 0, &r, segmentByte, &commas);
+    if(glass->digits > 1) glassDigit(glass, 1, &r, segmentByte, &commas);
+    if(glass->digits > 2) glassDigit(glass, 2, &r, segmentByte, &commas);
+    if(glass->digits > 3) glassDigit(glass, 3, &r, segmentByte, &commas);
+    if(glass->digits > 4) glassDigit(glass, 4, &r, segmentByte, &commas);
+    if(glass->digits > 5) glassDigit(glass, 5, &r, segmentByte, &commas);
+    if(glass->digits > 6) glassDigit(glass, 6, &r, segmentByte, &commas);   // GLASS_MAX_DIGITS
+
+    segmentByte[glass->commaByte] |= commas;
+    return 0;
+}
+
+#endif
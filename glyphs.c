@@ -0,0 +1,27 @@
+//
+// glyphs
+//
+// LXD Research & Display
+//
+// The glyph lookup table, generated from SEG_GLYPHS (see glyphs.h).
+// Replaces the toupper() + switch in sevenSegCode(): encoding is now a
+// single table read per character.
+//
+
+#include <stdint.h>
+
+#include "glyphs.h"
+
+
+#define GLYPH(upper, lower, segs) \
+    [(uint8_t)(upper)] = (segs) << 1, [(uint8_t)(lower)] = (segs) << 1,
+
+const uint8_t glyphTable[256] =
+{
+    [0 ... 255] = GLYPH_INVALID,
+    ['.'] = GLYPH_PERIOD,
+    [','] = GLYPH_COMMA,
+    SEG_GLYPHS
+};
+
+#undef GLYPH
@@ -0,0 +1,64 @@
+#ifndef _GLYPHS_H_
+#define _GLYPHS_H_
+
+// glyphs
+//
+// Seven segment glyphs for the H4235 and H4198 glass. Both glasses wire
+// segments a..g to bits 1..7 of each digit's segment byte, with the
+// period on bit 0, so one table serves both.
+//
+// SEG_GLYPHS is the single definition of every supported character; the
+// 256 entry glyphTable[] (in flash) is generated from it at compile time.
+
+#include <stdint.h>
+
+// GLYPH(upper case, lower case, segments gfedcba)
+//
+//   Dig   gfedcba
+//   ---   -------
+#define SEG_GLYPHS                  \
+    GLYPH(' ', ' ', 0x00)           \
+    GLYPH('-', '-', 0x40)           \
+    GLYPH('0', '0', 0x3F)           \
+    GLYPH('1', '1', 0x06)           \
+    GLYPH('2', '2', 0x5B)           \
+    GLYPH('3', '3', 0x4F)           \
+    GLYPH('4', '4', 0x66)           \
+    GLYPH('5', '5', 0x6D)           \
+    GLYPH('6', '6', 0x7D)           \
+    GLYPH('7', '7', 0x07)           \
+    GLYPH('8', '8', 0x7F)           \
+    GLYPH('9', '9', 0x6F)           \
+    GLYPH('A', 'a', 0x77)           \
+    GLYPH('B', 'b', 0x7C)           \
+    GLYPH('C', 'c', 0x39)           \
+    GLYPH('D', 'd', 0x5E)           \
+    GLYPH('E', 'e', 0x79)           \
+    GLYPH('F', 'f', 0x71)           \
+    /* "extended" chars */          \
+    GLYPH('G', 'g', 0x6f)           \
+    GLYPH('H', 'h', 0x76)           \
+    GLYPH('I', 'i', 0x06)           \
+    GLYPH('J', 'j', 0x0e)           \
+    GLYPH('L', 'l', 0x38)           \
+    GLYPH('N', 'n', 0x54)  /* this one's a stretch */ \
+    GLYPH('O', 'o', 0x3f)           \
+    GLYPH('P', 'p', 0x73)           \
+    GLYPH('S', 's', 0x6d)           \
+    GLYPH('T', 't', 0x78)  /* eh? */ \
+    GLYPH('U', 'u', 0x3E)           \
+    GLYPH('Y', 'y', 0x6e)
+    // No K, M, Q, R, V, W, X, Z
+
+
+// glyphTable[] entries are either a segment code, ready to OR into a
+// segment byte (segments in the upper 7 bits, bit 0 clear), or one of
+// these classes (bit 0 set):
+#define GLYPH_CLASS    0x01   // Set for anything that isn't a glyph
+#define GLYPH_PERIOD   0x01   // '.'
+#define GLYPH_COMMA    0x03   // ','
+#define GLYPH_INVALID  0xff   // Not displayable; skipped
+
+extern const uint8_t glyphTable[256];
+
+#endif
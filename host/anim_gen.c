@@ -0,0 +1,171 @@
+//
+// anim_gen
+//
+// LXD Research & Display
+//
+// Generates ../anim_table.c, the canned animations for lcdPlay(), from
+// the scripts below. Each frame is written as strings per LCD, encoded
+// here with the driver's own h4235/h4198_SetSegments(), so the target
+// only ever copies the raw segment bytes. The declarations are in
+// ../anim_table.h; keep the two in step.
+//
+// Usage: anim_gen > ../anim_table.c   (or "make anim")
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nxp_lcd_driver.h"
+
+
+#define ALL_ON_MS   1200     // As DEMO_HOLD_MS (demo.c)
+
+typedef struct
+{
+    uint16_t    ms;                  // Time on the glass
+    int         raw;                 // >= 0: every segment byte of every LCD, this
+    const char *s[LCD_S3 + 1];       // Else a string per LCD; 0 leaves it alone
+} scriptFrame;
+
+typedef struct
+{
+    const char        *name;         // The lcdAnim's C name
+    int                index;        // Element of an array of them; -1 if not
+    const char        *note;         // Comment for the table
+    int                n;
+    const scriptFrame *frames;
+} script;
+
+#define FRAMES(f)  (int)(sizeof(f) / sizeof(f[0])), f
+
+#define ALL_8S  { 0, "888.,8.,8.,8", "888.,8.,8.,8", "8.,8.,8.,8", "8.,8.,8.,8", "8.,8.,8.,8" }
+
+// Grade changeover, per grade: all segments on, then the grade's name
+// over "------" (the demo puts the prices up as that goes)
+static const scriptFrame change87[] =
+{
+    { ALL_ON_MS, -1, ALL_8S },
+    { 0,         -1, { 0, "  87  ", "------" } },
+};
+static const scriptFrame change100LL[] =
+{
+    { ALL_ON_MS, -1, ALL_8S },
+    { 0,         -1, { 0, " 100LL", "------" } },
+};
+static const scriptFrame changeJetA[] =
+{
+    { ALL_ON_MS, -1, ALL_8S },
+    { 0,         -1, { 0, " JET A", "------" } },
+};
+
+// End of the changeover, per grade: "----" on the other grades' price
+// LCDs (the chosen one keeps its price)
+static const scriptFrame list87[]    = { { 0, -1, { 0, 0, 0, 0,      "----", "----" } } };
+static const scriptFrame list100LL[] = { { 0, -1, { 0, 0, 0, "----", 0,      "----" } } };
+static const scriptFrame listJetA[]  = { { 0, -1, { 0, 0, 0, "----", "----", 0      } } };
+
+// Lamp test: all on, all off, then each segment bit in turn (a stuck or
+// shorted segment shows up against its neighbours), and off
+static const scriptFrame lampTest[] =
+{
+    { 500, 0xff }, { 250, 0x00 },
+    { 200, 0x01 }, { 200, 0x02 }, { 200, 0x04 }, { 200, 0x08 },
+    { 200, 0x10 }, { 200, 0x20 }, { 200, 0x40 }, { 200, 0x80 },
+    { 0,   0x00 },
+};
+
+static const script scripts[] =
+{
+    { "animChangeover", 0, "87",    FRAMES(change87) },
+    { "animChangeover", 1, "100LL", FRAMES(change100LL) },
+    { "animChangeover", 2, "JET A", FRAMES(changeJetA) },
+    { "animList",       0, "87",    FRAMES(list87) },
+    { "animList",       1, "100LL", FRAMES(list100LL) },
+    { "animList",       2, "JET A", FRAMES(listJetA) },
+    { "animLampTest",  -1, "",      FRAMES(lampTest) },
+};
+
+#define SCRIPTS  (int)(sizeof(scripts) / sizeof(scripts[0]))
+
+
+// Encode one frame, and print it as an lcdAnimFrame initializer
+static void frameOut(const scriptFrame *f)
+{
+    uint8_t seg[LCD_S3 + 1][8];
+    uint8_t lcds = 0;
+    int lcd, b;
+
+    memset(seg, 0, sizeof(seg));
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if(f->raw >= 0)
+            memset(seg[lcd], f->raw, sizeof(seg[lcd]));
+        else if(f->s[lcd] && lcd <= LCD_L2)
+            h4235_SetSegments(f->s[lcd], seg[lcd]);
+        else if(f->s[lcd])
+            h4198_SetSegments(f->s[lcd], seg[lcd]);
+        else
+            continue;
+        lcds |= 1 << lcd;
+    }
+
+    printf("    { %u, 0x%02x, {\n", f->ms, lcds);
+    for(lcd = 0; lcd <= LCD_S3; lcd++)
+    {
+        printf("        {");
+        for(b = 0; b < 8; b++)
+            printf(" 0x%02x%s", seg[lcd][b], b < 7 ? "," : "");
+        if(lcd == 0 || !(lcds & (1 << lcd)))
+            printf(" },\n");
+        else if(f->raw >= 0)
+            printf(" },   // 0x%02x\n", f->raw);
+        else
+            printf(" },   // \"%s\"\n", f->s[lcd]);
+    }
+    printf("    } },\n");
+}
+
+
+int main(void)
+{
+    int i, j, f;
+
+    printf("//\n"
+           "// anim_table\n"
+           "//\n"
+           "// LXD Research & Display\n"
+           "//\n"
+           "// Canned animations for lcdPlay(); see anim_table.h. Generated by\n"
+           "// host/anim_gen.c (make -C host anim): edit the scripts there, not this.\n"
+           "//\n"
+           "\n"
+           "#include \"anim_table.h\"\n");
+
+    for(i = 0; i < SCRIPTS; i++)
+    {
+        printf("\n\n// %s%s%s\n", scripts[i].name, *scripts[i].note ? " - " : "", scripts[i].note);
+        printf("static const lcdAnimFrame frames%d[] =\n{\n", i);
+        for(f = 0; f < scripts[i].n; f++)
+            frameOut(&scripts[i].frames[f]);
+        printf("};\n");
+    }
+
+    // The lcdAnims, each array's elements together and in order
+    printf("\n\n");
+    for(i = 0; i < SCRIPTS; i++)
+    {
+        if(scripts[i].index < 0)
+        {
+            printf("const lcdAnim %s = { frames%d, %d };\n", scripts[i].name, i, scripts[i].n);
+            continue;
+        }
+        if(scripts[i].index > 0)
+            continue;
+        printf("const lcdAnim %s[] =\n{\n", scripts[i].name);
+        for(j = i; j < SCRIPTS && !strcmp(scripts[j].name, scripts[i].name); j++)
+            printf("    { frames%d, %d },   // %s\n", j, scripts[j].n, scripts[j].note);
+        printf("};\n");
+    }
+    return 0;
+}
@@ -0,0 +1,536 @@
+//
+// bench_display
+//
+// LXD Research & Display
+//
+// Display pipeline benchmark. Replays update streams modelled on the
+// pump firmware through lcdBeginFrame()/lcdWrite()/lcdCommitFrame(),
+// against the controller emulator, and reports one JSON object per line
+// for each stream and SCL rate:
+//
+//   stream              fillup, changeover, flash or scroll
+//   scl_hz              Modelled SCL rate
+//   frames, chars       Frames in the stream, characters encoded
+//   encode_ns_per_char  Host CPU time in h4235/h4198_SetSegments()
+//   heads               Display sets driven at once, one per bus (-n)
+//   xfers_per_frame     I2C transactions per frame (mean, per head)
+//   bytes_per_frame     Bytes on the bus per frame, incl. slave addresses
+//   bus_us_per_frame    Modelled bus time per frame (mean and worst); the
+//                       buses run in parallel, so it's the busiest one's
+//   max_fps             Frames/s each head can sustain (1 / mean bus time)
+//   total_fps           The same, over all the heads
+//   double_buffered     Frames written to the hidden RAM bank, then flipped
+//
+// The encode figure is host time, so only compare it run-to-run on one
+// machine; the bus figures are exact for the model in lcd_bus_host.h.
+//
+// A last line compares the fill-up display update CPU cost (host ns per
+// tick, both lines, staged in a frame) as strings (fmtFixed() and
+// lcdWrite()) and as counters (lcdCounterSet()):
+//
+//   {"counter":"fillup","ticks":...,"string_ns_per_tick":...,"counter_ns_per_tick":...}
+//
+// The next compares a marquee step on line 1 (host ns, with the
+// scheduler pass that runs it) done as a 6 character substring and
+// lcdWrite(), and as an lcdScroll() step:
+//
+//   {"marquee":"scroll","steps":...,"string_ns_per_step":...,"scroll_ns_per_step":...}
+//
+// and the last two show the bus load of the fill-up frames offered at
+// update_hz (the demo's 1ms tick), written through (refresh_hz 0) and
+// coalesced (lcdRefreshRate()); dropped counts frames refused for a full
+// queue, and the bus figures are per frame offered:
+//
+//   {"coalesce":"fillup","update_hz":...,"refresh_hz":...,"frames":...,"dropped":...,
+//    "xfers_per_frame":...,"bytes_per_frame":...,"bus_us_per_frame":...}
+//
+// Usage: bench_display [-r encode_reps] [-b 0|1] [-n heads] [-s scl_hz]...
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nxp_lcd_driver.h"
+#include "dispense.h"
+#include "lcd_bus.h"
+#include "lcd_bus_host.h"
+#include "p32_utils.h"
+#include "sched.h"
+
+
+#define MAX_FRAMES   4096
+#define MAX_SCL      8
+#define COALESCE_HZ  25     // Refresh rate for the coalesced run
+
+typedef struct
+{
+    int  n;                  // Writes in the frame
+    struct
+    {
+        int  lcd;
+        char s[16];
+    } w[5];
+} benchFrame;
+
+static benchFrame frames[MAX_FRAMES];
+static int nFrames;
+static int dblBuf = 1;       // lcdDoubleBuffer() setting (-b)
+static int heads = 1;        // Display sets, on buses 0..heads-1 (-n)
+static nxpDisplay lcdSet[LCD_MAX_BUSES];
+
+
+static void frameAdd(int lcd, const char *s)
+{
+    benchFrame *f = &frames[nFrames];
+
+    snprintf(f->w[f->n].s, sizeof(f->w[0].s), "%s", s);
+    f->w[f->n].lcd = lcd;
+    f->n++;
+}
+
+
+static void frameNext(void)
+{
+    if(nFrames < MAX_FRAMES - 1)
+        nFrames++;
+    frames[nFrames].n = 0;
+}
+
+
+// Streams ----------------------------------------------------------------
+
+static const char *fuelName[] = { "  87  ", " 100LL", " JET A" };
+static const uint32_t pricePerGallon[] = { 3652, 3821, 4027 };
+
+
+// The main_p32.c fill-up loop: amount and volume, one frame per tick.
+static void streamFillup(void)
+{
+    dispenseSale sale;
+    char tmp[16];
+    int t;
+
+    dispenseStart(&sale, 0, pricePerGallon[1]);
+    for(t = 0; t < 2000; t++)
+    {
+        dispenseAdd(&sale, 9);
+        fmtFixed(tmp, sale.amount, 6, 2);
+        frameAdd(LCD_L1, tmp);
+        fmtFixed(tmp, sale.volume, 6, 3);
+        frameAdd(LCD_L2, tmp);
+        frameNext();
+    }
+}
+
+
+// Grade changeover: all segments, grade name & price list, the new price
+// flashing, then the "----" list with the chosen price.
+static void streamChangeover(void)
+{
+    char tmp[16];
+    int g, i;
+
+    for(g = 0; g < 3; g++)
+    {
+        frameAdd(LCD_L1, "888.,8.,8.,8");
+        frameAdd(LCD_L2, "888.,8.,8.,8");
+        for(i = 0; i < 3; i++) frameAdd(LCD_S1 + i, "8.,8.,8.,8");
+        frameNext();
+
+        frameAdd(LCD_L1, fuelName[g]);
+        frameAdd(LCD_L2, "------");
+        for(i = 0; i < 3; i++)
+        {
+            fmtFixed(tmp, pricePerGallon[i], 5, 3);
+            frameAdd(LCD_S1 + i, tmp);
+        }
+        frameNext();
+
+        fmtFixed(tmp, pricePerGallon[g], 5, 3);
+        for(i = 0; i < 4; i++)
+        {
+            frameAdd(LCD_S1 + g, "    ");
+            frameNext();
+            frameAdd(LCD_S1 + g, tmp);
+            frameNext();
+        }
+
+        for(i = 0; i < 3; i++) frameAdd(LCD_S1 + i, i == g ? tmp : "----");
+        frameNext();
+    }
+}
+
+
+// Price flashing: each small display in turn, on and off.
+static void streamFlash(void)
+{
+    char tmp[16];
+    int i, d;
+
+    for(i = 0; i < 300; i++)
+    {
+        d = i % 3;
+        fmtFixed(tmp, pricePerGallon[d], 5, 3);
+        frameAdd(LCD_S1 + d, (i / 3) & 1 ? "    " : tmp);
+        frameNext();
+    }
+}
+
+
+// Scrolling text: a message marched across both large display lines,
+// one character per frame.
+static const char scrollMsg[] =
+    "      PUSH TO BEGIN - SELECT FUEL - 100LL 3.821 - JET A 4.027 -      ";
+
+static void streamScroll(void)
+{
+    const char *msg = scrollMsg;
+    int len = sizeof(scrollMsg) - 1;
+    char tmp[8];
+    int i, k;
+
+    for(k = 0; k < 4; k++)
+    {
+        for(i = 0; i + 6 <= len; i++)
+        {
+            memcpy(tmp, msg + i, 6);
+            tmp[6] = 0;
+            frameAdd(LCD_L1, tmp);
+            memcpy(tmp, msg + len - 6 - i, 6);
+            frameAdd(LCD_L2, tmp);
+            frameNext();
+        }
+    }
+}
+
+
+// Measurement ------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// Encode every string in the stream 'reps' times; returns ns per char.
+static double benchEncode(int reps, long *chars)
+{
+    static volatile uint8_t sink;
+    uint8_t seg[8];
+    uint64_t t0, t;
+    long n = 0;
+    int r, f, w;
+
+    for(f = 0; f < nFrames; f++)
+        for(w = 0; w < frames[f].n; w++)
+            n += strlen(frames[f].w[w].s);
+    *chars = n;
+
+    t0 = nowNs();
+    for(r = 0; r < reps; r++)
+    {
+        for(f = 0; f < nFrames; f++)
+        {
+            for(w = 0; w < frames[f].n; w++)
+            {
+                if(frames[f].w[w].lcd <= LCD_L2)
+                    h4235_SetSegments(frames[f].w[w].s, seg);
+                else
+                    h4198_SetSegments(frames[f].w[w].s, seg);
+                sink ^= seg[0];
+            }
+        }
+    }
+    t = nowNs() - t0;
+
+    return n ? (double)t / ((double)n * reps) : 0;
+}
+
+
+// The fill-up ticks, rendered both ways on an initialized set (see top)
+static void benchCounter(nxpDisplay *d, int reps)
+{
+    dispenseSale sale;
+    char tmp[16];
+    uint64_t t0, tString, tCounter;
+    long ticks = 0;
+    int r, t;
+    i2cHandle h;
+
+    lcdBeginFrame(d);       // Staged only; the bus isn't part of it
+    t0 = nowNs();
+    for(r = 0; r < reps; r++)
+    {
+        dispenseStart(&sale, 0, pricePerGallon[1]);
+        for(t = 0; t < 2000; t++)
+        {
+            dispenseAdd(&sale, 9);
+            fmtFixed(tmp, sale.amount, 6, 2);
+            lcdWrite(d, LCD_L1, tmp);
+            fmtFixed(tmp, sale.volume, 6, 3);
+            lcdWrite(d, LCD_L2, tmp);
+        }
+    }
+    tString = nowNs() - t0;
+
+    t0 = nowNs();
+    for(r = 0; r < reps; r++)
+    {
+        dispenseStart(&sale, 0, pricePerGallon[1]);
+        lcdCounterStart(d, LCD_L1, sale.amount, 2);
+        lcdCounterStart(d, LCD_L2, sale.volume, 3);
+        for(t = 0; t < 2000; t++)
+        {
+            dispenseAdd(&sale, 9);
+            lcdCounterSet(d, LCD_L1, sale.amount);
+            lcdCounterSet(d, LCD_L2, sale.volume);
+        }
+        ticks += t;
+    }
+    tCounter = nowNs() - t0;
+    lcdCommitFrame(d, &h);
+    i2cWait(d->bus, h);
+
+    printf("{\"counter\":\"fillup\",\"ticks\":%ld,"
+           "\"string_ns_per_tick\":%.2f,\"counter_ns_per_tick\":%.2f}\n",
+           ticks, (double)tString / ticks, (double)tCounter / ticks);
+}
+
+
+// The scroll message stepped across line 1 both ways, a step per ms of
+// virtual time, on an initialized set (see top)
+static void benchMarquee(nxpDisplay *d, int reps)
+{
+    int len = sizeof(scrollMsg) - 1;
+    char tmp[8];
+    uint64_t t0, tString, tScroll;
+    long steps = 0;
+    int r, i;
+    i2cHandle h;
+
+    lcdBeginFrame(d);       // Staged only; the bus isn't part of it
+    t0 = nowNs();
+    for(r = 0; r < reps; r++)
+    {
+        for(i = 0; i + 6 <= len; i++)
+        {
+            memcpy(tmp, scrollMsg + i, 6);
+            tmp[6] = 0;
+            lcdWrite(d, LCD_L1, tmp);
+            hostAdvance(1000000);
+            schedRunOnce();
+        }
+    }
+    tString = nowNs() - t0;
+
+    lcdScroll(d, LCD_L1, scrollMsg, 1);
+    t0 = nowNs();
+    for(r = 0; r < reps; r++)
+    {
+        for(i = 0; i + 6 <= len; i++)
+        {
+            hostAdvance(1000000);
+            schedRunOnce();
+        }
+        steps += i;
+    }
+    tScroll = nowNs() - t0;
+    lcdScroll(d, LCD_L1, 0, 0);
+    lcdCommitFrame(d, &h);
+    i2cWait(d->bus, h);
+
+    printf("{\"marquee\":\"scroll\",\"steps\":%ld,"
+           "\"string_ns_per_step\":%.2f,\"scroll_ns_per_step\":%.2f}\n",
+           steps, (double)tString / steps, (double)tScroll / steps);
+}
+
+
+// The fill-up stream offered to an initialized set at one frame per ms
+// of virtual time, with the main loop running in between, coalesced at
+// refresh hz (0: written through). See top.
+static void benchCoalesce(nxpDisplay *d, int hz)
+{
+    hostBusStats start = hostBus[d->bus];
+    uint64_t t0, busNs;
+    int f, w, dropped = 0;
+    i2cHandle h;
+
+    nFrames = 0;
+    frames[0].n = 0;
+    streamFillup();
+
+    lcdRefreshRate(d, hz);
+    t0 = hostClockNs;
+    busNs = hostBusNs();
+    for(f = 0; f < nFrames; f++)
+    {
+        lcdBeginFrame(d);
+        for(w = 0; w < frames[f].n; w++)
+            lcdWrite(d, frames[f].w[w].lcd, frames[f].w[w].s);
+        if(lcdCommitFrame(d, 0))
+            dropped++;
+        while(hostClockNs < t0 + (f + 1) * 1000000ULL)
+        {
+            if(!schedRunOnce())
+                delay_us(50);
+        }
+    }
+    lcdFlush(d, &h);
+    i2cWait(d->bus, h);
+    busNs = hostBusNs() - busNs;
+    lcdRefreshRate(d, 0);
+
+    printf("{\"coalesce\":\"fillup\",\"update_hz\":1000,\"refresh_hz\":%d,\"frames\":%d,\"dropped\":%d,"
+           "\"xfers_per_frame\":%.3f,\"bytes_per_frame\":%.3f,\"bus_us_per_frame\":%.1f}\n",
+           hz, nFrames, dropped,
+           (double)(hostBus[d->bus].transactions - start.transactions) / nFrames,
+           (double)(hostBus[d->bus].bytes - start.bytes) / nFrames,
+           busNs / 1e3 / nFrames);
+}
+
+
+// Play the stream over the emulated buses at one SCL rate, from freshly
+// initialized drivers, and print its JSON line. Every head gets the same
+// frames, each frame queued to all of them before any is waited on.
+static void benchBus(const char *name, uint32_t scl, double encNs, long chars)
+{
+    hostBusStats start[LCD_MAX_BUSES];
+    nxpConfig cfg = { 0, LCD_A1, LCD_A2, NXP_ALL_LCDS };
+    uint64_t before, busNs, worstNs = 0;
+    uint32_t errors = 0;
+    uint32_t xfers = 0, bytes = 0, nacks = 0;
+    i2cHandle h[LCD_MAX_BUSES];
+    int f, w, b, ready;
+
+    for(b = 0; b < heads; b++)
+    {
+        cfg.bus = b;
+        nxpInit(&lcdSet[b], &cfg, 40000000);
+    }
+    do
+    {
+        schedRunOnce();
+        delay_us(100);
+        for(ready = 0, b = 0; b < heads; b++)
+            ready += nxpReady(&lcdSet[b]);
+    } while(ready < heads);
+
+    for(b = 0; b < heads; b++)
+    {
+        i2cSetSpeed(b, scl);
+        lcdDoubleBuffer(&lcdSet[b], dblBuf);
+        start[b] = hostBus[b];
+        errors -= i2cErrorCount(b);
+    }
+    busNs = hostBusNs();
+    for(f = 0; f < nFrames; f++)
+    {
+        before = hostBusNs();
+        for(b = 0; b < heads; b++)
+        {
+            lcdBeginFrame(&lcdSet[b]);
+            for(w = 0; w < frames[f].n; w++)
+                lcdWrite(&lcdSet[b], frames[f].w[w].lcd, frames[f].w[w].s);
+            lcdCommitFrame(&lcdSet[b], &h[b]);
+        }
+        for(b = 0; b < heads; b++)
+            i2cWait(b, h[b]);
+
+        if(hostBusNs() - before > worstNs)
+            worstNs = hostBusNs() - before;
+    }
+    busNs = hostBusNs() - busNs;
+
+    for(b = 0; b < heads; b++)
+    {
+        xfers += hostBus[b].transactions - start[b].transactions;
+        bytes += hostBus[b].bytes - start[b].bytes;
+        nacks += hostBus[b].nacks - start[b].nacks;
+        errors += i2cErrorCount(b);
+    }
+
+    printf("{\"stream\":\"%s\",\"scl_hz\":%u,\"heads\":%d,\"frames\":%d,\"chars\":%ld,"
+           "\"encode_ns_per_char\":%.2f,"
+           "\"xfers_per_frame\":%.3f,\"bytes_per_frame\":%.3f,"
+           "\"bus_us_per_frame\":%.1f,\"bus_us_worst\":%.1f,"
+           "\"max_fps\":%.1f,\"total_fps\":%.1f,\"double_buffered\":%s,\"nacks\":%u,\"errors\":%u}\n",
+           name, scl, heads, nFrames, chars, encNs,
+           (double)xfers / nFrames / heads,
+           (double)bytes / nFrames / heads,
+           busNs / 1e3 / nFrames, worstNs / 1e3,
+           busNs ? 1e9 * nFrames / busNs : 0.0,
+           busNs ? 1e9 * nFrames * heads / busNs : 0.0, dblBuf ? "true" : "false",
+           nacks, errors);
+}
+
+
+static const struct
+{
+    const char *name;
+    void (*build)(void);
+} streams[] =
+{
+    { "fillup",     streamFillup },
+    { "changeover", streamChangeover },
+    { "flash",      streamFlash },
+    { "scroll",     streamScroll },
+};
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t scl[MAX_SCL];
+    int nScl = 0;
+    int reps = 200;
+    int opt, s, i;
+    long chars;
+    double encNs;
+
+    while((opt = getopt(argc, argv, "r:b:n:s:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'r': reps = atoi(optarg); break;
+            case 'b': dblBuf = atoi(optarg); break;
+            case 'n': heads = atoi(optarg); break;
+            case 's': if(nScl < MAX_SCL) scl[nScl++] = strtoul(optarg, 0, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-r encode_reps] [-b 0|1] [-n heads] [-s scl_hz]...\n", argv[0]);
+                return 1;
+        }
+    }
+    if(nScl == 0)
+    {
+        scl[nScl++] = 100000;
+        scl[nScl++] = 400000;
+    }
+    if(reps < 1)
+        reps = 1;
+    if(heads < 1)
+        heads = 1;
+    if(heads > LCD_MAX_BUSES)
+        heads = LCD_MAX_BUSES;
+
+    for(s = 0; s < (int)(sizeof(streams) / sizeof(streams[0])); s++)
+    {
+        nFrames = 0;
+        frames[0].n = 0;
+        streams[s].build();
+
+        encNs = benchEncode(reps, &chars);
+        for(i = 0; i < nScl; i++)
+            benchBus(streams[s].name, scl[i], encNs, chars);
+    }
+    benchCounter(&lcdSet[0], reps);
+    benchMarquee(&lcdSet[0], reps);
+    benchCoalesce(&lcdSet[0], 0);
+    benchCoalesce(&lcdSet[0], COALESCE_HZ);
+    return 0;
+}
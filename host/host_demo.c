@@ -0,0 +1,383 @@
+//
+// host_demo
+//
+// LXD Research & Display
+//
+// Runs the LCD driver on a Linux box against the controller emulator:
+// nxpInit() and the demo task (demo.c) under the scheduler, as on the
+// board, printing the emulated glass and the bus accounting.
+//
+// -F n injects a bus fault every n ticks, alternately a lost interrupt
+// and a slave holding SDA, to exercise the I2C time limits and recovery.
+//
+// -M hz makes the wiring fail (every byte NACK'd) above hz from the
+// start, so nxpInit()'s speed negotiation has to back off; -S hz does
+// the same half way through the run, for the NACK-rate step down. -s hz
+// overrides the negotiated speed.
+//
+// -P us holds the controllers in power-on reset (NACKing) for us after
+// the supply comes on, for nxpInit()'s ACK polling; -L runs the lamp
+// test (animLampTest) as soon as the displays are ready, over the start
+// of the demo.
+//
+// Built with FLOW_PULSER (make FLOW=1), the demo's volume comes from the
+// simulated pulser, at -p pulses per minute.
+//
+// Built with POS_LINK (make POS=1), a site controller talks to it half
+// way through the run: new prices and text for the small LCDs (among
+// some line noise and a damaged frame), then a grade selection, a resend
+// of it, and an unknown command. Its replies are listed at the end.
+//
+// Built with I2C_TRACE (make TRACE=1), -t file dumps the I2C trace to
+// file as the run goes, for trace_dec.
+//
+// Usage: host_demo [-s scl_hz] [-n ticks] [-F fault_ticks] [-M hz] [-S hz] [-P us] [-L] [-p ppm] [-t file] [-q]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "nxp_lcd_driver.h"
+#include "sched.h"
+#include "demo.h"
+#include "anim_table.h"
+#include "lcd_bus.h"
+#include "lcd_bus_host.h"
+#include "nxp_emu.h"
+#include "p32_utils.h"
+#include "perf_stats.h"
+#include "flow.h"
+#include "pulser.h"
+#include "pulser_host.h"
+#include "cpu_load.h"
+#include "pos_link.h"
+#include "uart.h"
+#include "uart_host.h"
+#include "i2c_trace.h"
+
+
+static int quiet;
+static FILE *traceFile;
+static nxpDisplay lcdSet;
+static const nxpConfig lcdConfig = { 0, LCD_A1, LCD_A2, NXP_ALL_LCDS };
+
+
+static void show(const char *title)
+{
+    lcdFlush(&lcdSet, 0);   // Don't wait for the refresh timer
+    busPoll(0);             // Let anything queued reach the glass
+    if(quiet)
+        return;
+    printf("--- %s\n", title);
+    emuRender(0, stdout);
+}
+
+
+static void report(const char *what, const hostBusStats *from)
+{
+    hostBusStats d;
+
+    d.transactions = hostBus[0].transactions - from->transactions;
+    d.bytes = hostBus[0].bytes - from->bytes;
+    d.nacks = hostBus[0].nacks - from->nacks;
+    d.busNs = hostBus[0].busNs - from->busNs;
+    d.recoveries = hostBus[0].recoveries - from->recoveries;
+    printf("%-10s %6u transactions %8u bytes %4u nacks %3u recoveries %10.3f ms bus time @ %u Hz\n",
+           what, d.transactions, d.bytes, d.nacks, d.recoveries, d.busNs / 1e6, hostBusScl(0));
+}
+
+
+#ifdef LCD_PERF_STATS
+static void perfTimerReport(const char *what, volatile perfTimer *t)
+{
+    double us = 1e6 / PERF_TICK_HZ;
+    int b;
+
+    if(t->count == 0)
+        return;
+    printf("%-10s %8u calls  min %8.2f  mean %8.2f  max %8.2f us  hist",
+           what, t->count, t->min * us, (double)t->total / t->count * us, t->max * us);
+    for(b = 0; b < PERF_HIST_BUCKETS; b++)
+        printf(" %u", t->hist[b]);
+    printf("\n");
+}
+
+
+static void perfReport(void)
+{
+    perfTimerReport("lcdWrite", &lcdPerf.lcdWrite);
+    perfTimerReport("encode", &lcdPerf.encode);
+    perfTimerReport("rawWrite", &lcdPerf.rawWrite);
+    perfTimerReport("queueWait", &lcdPerf.queueWait);
+    perfTimerReport("busTime", &lcdPerf.busTime);
+    perfTimerReport("stall", &lcdPerf.stall);
+    printf("%u transactions, %u bytes, %u nacks, %u errors, %u idle stalls, %u stop recoveries\n",
+           lcdPerf.transactions, lcdPerf.bytes, lcdPerf.nacks, lcdPerf.errors,
+           lcdPerf.idleStalls, lcdPerf.stopRecoveries);
+}
+#endif
+
+
+#ifdef FLOW_PULSER
+static void flowReport(void)
+{
+    flowSnapshot f;
+
+    flowRead(&f);
+    printf("flow: %u pulses, %u.%03u gal, %u.%03u gal/min, %u overruns\n",
+           f.pulses, f.volume / 1000, f.volume % 1000, f.rate / 1000, f.rate % 1000,
+           pulserOverruns());
+}
+#endif
+
+
+#ifdef CPU_LOAD_STATS
+// CPU load over the whole run (the completed windows). Host time, so
+// only the shape of it means much; see cpu_load.h.
+static void cpuReport(void)
+{
+    static const char *className[CPU_CLASSES] = { "idle", "app", "display", "bus", "irq" };
+    uint64_t sum = 0;
+    int c;
+
+    for(c = 0; c < CPU_CLASSES; c++)
+        sum += cpuLoad.total[c];
+    if(sum == 0)
+        return;
+    printf("cpu load over %u windows:", cpuLoad.windows);
+    for(c = 0; c < CPU_CLASSES; c++)
+        printf("  %s %.1f%%", className[c], cpuLoad.total[c] * 100.0 / sum);
+    printf("\n");
+}
+#endif
+
+
+#ifdef POS_LINK
+static uint8_t posSeq;
+
+// Send a frame from the "site controller"; bad flips a bit in it
+static void posSend(uint8_t seq, uint8_t cmd, const uint8_t *p, int n, int bad)
+{
+    uint8_t f[POS_FRAME_MAX];
+    int len = posEncode(f, seq, cmd, p, n);
+
+    if(bad)
+        f[len - 3] ^= 0x10;
+    hostUartFeed(f, len);
+}
+
+
+static void posScript(int part)
+{
+    static const uint8_t noise[] = { 0x00, POS_SOF, 0xff, 0x13, POS_SOF };
+    static const uint8_t prices[] =       // 87 at 3.483, JET A at 4.199
+    {
+        0, 0x9b, 0x0d, 0x00, 0x00,
+        2, 0x67, 0x10, 0x00, 0x00,
+    };
+    static const uint8_t text[] =
+    {
+        LCD_S1, 4, 'P', 'O', 'S', ' ',
+        LCD_S2, 4, 'L', 'I', 'N', 'E',
+        LCD_S3, 4, 'U', 'P', '.', '.',
+    };
+    static const uint8_t grade[] = { 1 };
+
+    if(part == 0)
+    {
+        hostUartFeed(noise, sizeof(noise));
+        posSend(++posSeq, POS_PING, 0, 0, 0);
+        posSend(++posSeq, POS_PRICE, prices, sizeof(prices), 1);
+        posSend(posSeq, POS_PRICE, prices, sizeof(prices), 0);
+        posSend(++posSeq, POS_TEXT, text, sizeof(text), 0);
+    }
+    else
+    {
+        posSend(++posSeq, POS_GRADE, grade, sizeof(grade), 0);
+        posSend(posSeq, POS_GRADE, grade, sizeof(grade), 0);
+        posSend(++posSeq, 0x55, 0, 0, 0);
+    }
+}
+
+
+// The replies, as the site controller would see them
+static void posReport(void)
+{
+    uint8_t b[UART_TX_RING];
+    int n = hostUartSent(b, sizeof(b));
+    int i;
+
+    for(i = 0; i + 8 <= n; i += 8)
+        printf("pos reply: seq %u cmd 0x%02x status %u\n", b[i + 2], b[i + 4], b[i + 5]);
+    printf("pos: %u frames, %u bytes dropped, %u uart errors\n", posFrames(), posDropped(), uartErrors());
+}
+#endif
+
+
+#ifdef I2C_TRACE
+// The debug channel: the trace file
+static int traceWrite(const uint8_t *buf, int n)
+{
+    return fwrite(buf, 1, n, traceFile);
+}
+#endif
+
+
+// Run the scheduler, idling (letting virtual time pass) when nothing is
+// due, as the board's main loop does
+static void run(void)
+{
+    if(!schedRunOnce())
+        cpuIdle();
+#ifdef I2C_TRACE
+    if(traceFile)
+        i2cTraceDump(traceWrite);
+#endif
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const char *stateName[] =
+    {
+        "", "start-up pattern", "fill-up",
+        "all segments", "grade & prices", "price flash", "price list",
+        "counters"
+    };
+    uint32_t scl = 0;
+    uint32_t maxScl = 0, laterMaxScl = 0, negotiated;
+    long ticks = 5000;
+    long faultTicks = 0;
+    int lamp = 0;
+    uint32_t pulseRate = 6000;   // 60 gal/min at FLOW_K_FACTOR 100000
+    int faults = 0;
+    uint32_t lastTick = 0;
+    int opt, state, lastState;
+    hostBusStats start;
+
+    while((opt = getopt(argc, argv, "s:n:F:M:S:P:Lp:t:q")) != -1)
+    {
+        switch(opt)
+        {
+            case 's': scl = strtoul(optarg, 0, 0); break;
+            case 'n': ticks = strtol(optarg, 0, 0); break;
+            case 'F': faultTicks = strtol(optarg, 0, 0); break;
+            case 'M': maxScl = strtoul(optarg, 0, 0); break;
+            case 'S': laterMaxScl = strtoul(optarg, 0, 0); break;
+            case 'P': hostFault[0].powerUpUs = strtoul(optarg, 0, 0); break;
+            case 'L': lamp = 1; break;
+            case 'p': pulseRate = strtoul(optarg, 0, 0); break;
+            case 't':
+                if(!(traceFile = fopen(optarg, "w")))
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'q': quiet = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-s scl_hz] [-n ticks] [-F fault_ticks] [-M hz] [-S hz] [-P us] [-L] [-p ppm] [-t file] [-q]\n", argv[0]);
+                return 1;
+        }
+    }
+#ifndef I2C_TRACE
+    if(traceFile)
+        fprintf(stderr, "-t: no trace in this build (make TRACE=1)\n");
+#endif
+
+    memset(&start, 0, sizeof(start));
+    hostFault[0].maxScl = maxScl;
+    schedInit(40000000);
+#ifdef CPU_LOAD_STATS
+    cpuLoadStart();
+#endif
+#ifdef FLOW_PULSER
+    flowInit(40000000, FLOW_K_FACTOR);
+    hostPulserRate(pulseRate);
+#else
+    (void)pulseRate;
+#endif
+    nxpInit(&lcdSet, &lcdConfig, 40000000);
+    while(!nxpReady(&lcdSet))
+        run();
+    negotiated = nxpBusSpeed(&lcdSet);
+    report("nxpInit", &start);
+    printf("ready after %.3f ms\n", (hostClockNs + hostBusNs()) / 1e6);
+    if(scl)
+        i2cSetSpeed(0, scl);
+    show("after nxpInit");
+    if(lamp)
+        lcdLampTest(&lcdSet, &animLampTest);
+
+    // The demo task, as on the board, until it has run 'ticks' fill-up
+    // ticks. The glass is shown as each state is left (i.e. once its
+    // last writes have gone out).
+    start = hostBus[0];
+    demoStart(&lcdSet);
+#ifdef POS_LINK
+    posInit(&lcdSet, 40000000, POS_BAUD);
+#endif
+    lastState = demoState();
+    while(demoTicks() < (uint32_t)ticks)
+    {
+        run();
+
+        state = demoState();
+        if(state != lastState)
+        {
+            if(lastState != DEMO_WAIT_LCD)
+                show(stateName[lastState]);
+            lastState = state;
+        }
+
+        if(faultTicks && demoTicks() != lastTick && demoTicks() % faultTicks == 0)
+        {
+            if(faults++ & 1)
+                hostFault[0].holdSda = 1;
+            else
+                hostFault[0].loseEvents = 1;
+        }
+        if(laterMaxScl && demoTicks() == (uint32_t)ticks / 2)
+            hostFault[0].maxScl = laterMaxScl;
+#ifdef POS_LINK
+        if(demoTicks() != lastTick && demoTicks() == (uint32_t)ticks / 2)
+            posScript(0);
+        if(demoTicks() != lastTick && demoTicks() == (uint32_t)ticks / 2 + 10)
+        {
+            show("POS text");
+            posScript(1);
+        }
+#endif
+        lastTick = demoTicks();
+    }
+    show("end of run");
+    report("main loop", &start);
+    printf("bus speed: %u Hz negotiated, %u Hz at the end\n", negotiated, nxpBusSpeed(&lcdSet));
+    if(faults)
+        printf("%d faults injected, %u failed transactions\n", faults, i2cErrorCount(0));
+#ifdef FLOW_PULSER
+    flowReport();
+#endif
+#ifdef POS_LINK
+    posReport();
+#endif
+#ifdef LCD_PERF_STATS
+    perfReport();
+#endif
+#ifdef CPU_LOAD_STATS
+    cpuReport();
+#endif
+#ifdef I2C_TRACE
+    if(traceFile)
+    {
+        i2cTraceDump(traceWrite);
+        fclose(traceFile);
+        printf("i2c trace: %u records dropped\n", i2cTraceDropped(0));
+    }
+#endif
+
+    return 0;
+}
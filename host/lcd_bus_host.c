@@ -0,0 +1,189 @@
+//
+// lcd_bus_host
+//
+// LXD Research & Display
+//
+// Linux host backend for lcd_bus.h. Each bus operation is handed to the
+// controller emulator straight away, and its completion event is held
+// until busPoll() (which stands in for the I2C interrupt). busPoll() is
+// called by i2cWait() and the delay shims, or by the host program.
+//
+// Every bus number up to LCD_MAX_BUSES exists here, each with its own
+// emulated board, statistics and faults.
+//
+
+#include <stdint.h>
+
+#include "lcd_bus.h"
+#include "lcd_bus_host.h"
+#include "nxp_emu.h"
+#include "cpu_load.h"
+
+
+hostBusStats hostBus[LCD_MAX_BUSES];
+hostBusFaults hostFault[LCD_MAX_BUSES];
+
+static struct
+{
+    uint32_t sclHz;
+    uint32_t bitNs;         // ns per SCL period
+    int pendingEvent;       // Event waiting for busPoll(), or -1
+    int masked;             // Events masked by busIntEnable(0)
+    int lastAck;
+    uint64_t readyNs;       // Power-on reset over (hostClockNs + hostBusNs())
+} bs[LCD_MAX_BUSES];
+
+
+void hostBusSetScl(int bus, uint32_t hz)
+{
+    bs[bus].sclHz = hz;
+    bs[bus].bitNs = 1000000000UL / hz;
+}
+
+
+uint32_t hostBusScl(int bus)
+{
+    return bs[bus].sclHz;
+}
+
+
+uint32_t busInit(int bus, int pbClk, uint32_t hz)
+{
+    (void)pbClk;
+    if(bus < 0 || bus >= LCD_MAX_BUSES)
+        return 0;
+    emuReset(bus);   // Supply switched on: power-on reset
+    bs[bus].readyNs = hostClockNs + hostBusNs() + hostFault[bus].powerUpUs * 1000ULL;
+    hostBusSetScl(bus, hz);
+    bs[bus].pendingEvent = -1;
+    bs[bus].masked = 0;
+    return hz;
+}
+
+
+// Post a completion event for busPoll(), unless it's to be lost
+static void busDone(int bus)
+{
+    if(hostFault[bus].loseEvents)
+        hostFault[bus].loseEvents--;
+    else
+        bs[bus].pendingEvent = BUS_EV_DONE;
+}
+
+
+uint32_t busSetSpeed(int bus, uint32_t hz)
+{
+    hostBusSetScl(bus, hz);
+    return hz;
+}
+
+
+int busIsIdle(int bus)
+{
+    return bs[bus].pendingEvent < 0 && !hostFault[bus].holdSda && !hostFault[bus].stuck;
+}
+
+
+int busStart(int bus)
+{
+    emuStart(bus);
+    hostBus[bus].transactions++;
+    hostBus[bus].busNs += bs[bus].bitNs;
+    busDone(bus);
+    return 0;
+}
+
+
+int busSendByte(int bus, uint8_t b)
+{
+    if(hostFault[bus].maxScl && bs[bus].sclHz > hostFault[bus].maxScl)
+        bs[bus].lastAck = 0;        // Too fast for the wiring; garbled
+    else if(hostClockNs + hostBusNs() < bs[bus].readyNs)
+        bs[bus].lastAck = 0;        // Still in power-on reset
+    else
+        bs[bus].lastAck = emuByte(bus, b);
+    hostBus[bus].bytes++;
+    if(!bs[bus].lastAck)
+        hostBus[bus].nacks++;
+    hostBus[bus].busNs += 9 * bs[bus].bitNs;
+    busDone(bus);
+    return 0;
+}
+
+
+int busAcked(int bus)
+{
+    return bs[bus].lastAck;
+}
+
+
+void busStop(int bus)
+{
+    emuStop(bus);
+    hostBus[bus].busNs += bs[bus].bitNs;
+    busDone(bus);
+}
+
+
+void busIntEnable(int bus, int on)
+{
+    bs[bus].masked = !on;
+}
+
+
+// busPoll - Deliver held events until the engine goes quiet
+//
+void busPoll(int bus)
+{
+    CPU_IRQ_VAR(t0)
+    int ev;
+
+    if(bs[bus].pendingEvent < 0)
+        hostAdvance(1000);     // Spinning on nothing; let time pass
+
+    while(bs[bus].pendingEvent >= 0 && !bs[bus].masked)
+    {
+        ev = bs[bus].pendingEvent;
+        bs[bus].pendingEvent = -1;
+        CPU_IRQ_ENTER(t0);
+        i2cBusEvent(bus, ev);
+        CPU_IRQ_LEAVE(CPU_BUS, t0);
+    }
+}
+
+
+// hostBusNs - Modelled bus time: the buses run side by side, so it's
+// the busiest one's
+//
+uint64_t hostBusNs(void)
+{
+    uint64_t ns = 0;
+    int bus;
+
+    for(bus = 0; bus < LCD_MAX_BUSES; bus++)
+        if(hostBus[bus].busNs > ns)
+            ns = hostBus[bus].busNs;
+    return ns;
+}
+
+
+// busNow - Virtual time, in core timer ticks
+//
+uint32_t busNow(void)
+{
+    return (uint32_t)((hostClockNs + hostBusNs()) * BUS_TICKS_PER_US / 1000);
+}
+
+
+// busRecover - 9 clocks and a stop (modelled as 10 SCL periods, plus
+// the pin setup). Frees a held SDA, unless it's stuck for good.
+//
+int busRecover(int bus)
+{
+    emuStop(bus);
+    hostBus[bus].recoveries++;
+    hostBus[bus].busNs += 12 * bs[bus].bitNs;
+    bs[bus].pendingEvent = -1;
+    hostFault[bus].holdSda = 0;
+    return hostFault[bus].stuck;
+}
@@ -0,0 +1,56 @@
+#ifndef _LCD_BUS_HOST_H_
+#define _LCD_BUS_HOST_H_
+
+// lcd_bus_host
+//
+// Host (Linux) backend for lcd_bus.h: feeds the bytes the engine puts on
+// the "bus" to the controller emulator (nxp_emu.c), and keeps exact
+// bytes-on-bus and modelled bus-time accounting at the configured SCL
+// rate.
+//
+// Bus time model, in SCL periods: start 1, each byte (address or data)
+// 9 (8 bits + ACK), stop 1.
+//
+// Each bus (lcd_bus.h) has its own emulated board, SCL rate, statistics
+// and faults, indexed by bus number.
+
+#include <stdint.h>
+
+#include "lcd_bus.h"
+
+typedef struct
+{
+    uint32_t transactions;   // Start conditions
+    uint32_t bytes;          // Bytes on the bus, including slave addresses
+    uint32_t nacks;          // Bytes not acknowledged
+    uint64_t busNs;          // Modelled bus time
+    uint32_t recoveries;     // busRecover() calls
+} hostBusStats;
+
+extern hostBusStats hostBus[LCD_MAX_BUSES];
+
+// Fault injection, for exercising the engine's time limits and recovery
+typedef struct
+{
+    uint32_t loseEvents;     // Drop the next n completion events (lost interrupts)
+    uint8_t  holdSda;        // A slave holds SDA low until busRecover() frees it
+    uint8_t  stuck;          // SDA held low for good; busRecover() fails
+    uint32_t maxScl;         // If non-zero, every byte is NACK'd above this rate
+    uint32_t powerUpUs;      // Controllers NACK for this long after busInit() (power-on reset)
+} hostBusFaults;
+
+extern hostBusFaults hostFault[LCD_MAX_BUSES];
+
+// Change the modelled SCL rate (busInit() sets it too)
+void hostBusSetScl(int bus, uint32_t sclHz);
+uint32_t hostBusScl(int bus);
+
+// Virtual time, advanced by delay_ms()/delay_us() and by busPoll() when
+// it has nothing to deliver (a spinning CPU) (ns). busNow() is this plus
+// the modelled bus time: the buses run side by side, so that's the
+// largest busNs (hostBusNs()).
+extern uint64_t hostClockNs;
+void hostAdvance(uint64_t ns);
+uint64_t hostBusNs(void);
+
+#endif
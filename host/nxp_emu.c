@@ -0,0 +1,365 @@
+//
+// nxp_emu
+//
+// LXD Research & Display
+//
+// Host-side model of the PCF85176 / PCF85134 LCD controllers, used to run
+// and measure the LCD driver on a Linux box. See nxp_emu.h.
+//
+// Command bytes (PCF85176 has the C continuation bit in bit 7; the
+// PCF85134 instead sends a control byte, Co + RS, ahead of commands/data):
+//
+//                        PCF85176           PCF85134
+//   Mode set             C100 EBMM          1100 EBMM
+//   Load data pointer    C0PP PPPP          0PPP PPPP
+//   Device select        C110 0AAA          1110 0AAA
+//   Bank select          C111 10IO          1111 10IO
+//   Blink select         C111 0ABB          1111 0ABB
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lcd_bus.h"
+#include "nxp_emu.h"
+
+
+emuDevice emuDev[LCD_MAX_BUSES][EMU_DEVICES];
+
+// Transaction state, shared by the controllers at an address (they all
+// see the same bus traffic); one set per bus
+#define PH_IDLE     0   // No transaction, or not addressed
+#define PH_ADDR     1   // Next byte is the slave address
+#define PH_CMD      2   // PCF85176: next byte is a command
+#define PH_CTRL     3   // PCF85134: next byte is a control byte
+#define PH_ONE_CMD  4   // PCF85134: one command, then a control byte
+#define PH_ONE_DATA 5   // PCF85134: one data byte, then a control byte
+#define PH_CMDS     6   // PCF85134: commands until the stop
+#define PH_DATA     7   // Display data until the stop
+
+typedef struct
+{
+    int     phase;
+    uint8_t curSa;           // Address of this transaction
+    uint8_t curType;         // Controller type at that address
+
+    // Data pointer and subaddress counter, per slave address: [0] 0x70, [1] 0x72
+    struct { uint8_t ptr; uint8_t sub; } counters[2];
+} emuBusState;
+
+static emuBusState busState[LCD_MAX_BUSES];
+
+
+static void emuPowerOn(emuDevice *d, uint8_t type, uint8_t sa, uint8_t sub)
+{
+    memset(d, 0, sizeof(*d));
+    d->type = type;
+    d->sa = sa;
+    d->subaddr = sub;
+    d->nSegs = (type == EMU_PCF85176) ? 40 : 60;
+    d->mode = 0;         // 1:4 multiplex
+    d->enabled = 0;      // Display disabled
+}
+
+
+void emuReset(int bus)
+{
+    emuDevice *dev = emuDev[bus];
+
+    emuPowerOn(&dev[0], EMU_PCF85176, 0x70, 0);   // H4198 left
+    emuPowerOn(&dev[1], EMU_PCF85176, 0x70, 1);   // H4198 middle
+    emuPowerOn(&dev[2], EMU_PCF85176, 0x70, 2);   // H4198 right
+    emuPowerOn(&dev[3], EMU_PCF85134, 0x72, 0);   // H4235 bottom line
+    emuPowerOn(&dev[4], EMU_PCF85134, 0x72, 1);   // H4235 top line
+    memset(&busState[bus], 0, sizeof(busState[bus]));
+    busState[bus].phase = PH_IDLE;
+}
+
+
+static int counterIndex(uint8_t sa)
+{
+    return sa == 0x70 ? 0 : 1;
+}
+
+
+// Execute one command (continuation/control bits already stripped where
+// they aren't part of the opcode)
+static void emuCommand(int bus, uint8_t b)
+{
+    emuBusState *s = &busState[bus];
+    uint8_t curSa = s->curSa;
+    uint8_t curType = s->curType;
+    int i;
+    int c = counterIndex(curSa);
+    emuDevice *d;
+
+    if(curType == EMU_PCF85176)
+        b |= 0x80;   // Align with the PCF85134 opcodes
+
+    if(!(b & 0x80) || (curType == EMU_PCF85176 && !(b & 0x40)))
+    {
+        // Load data pointer
+        s->counters[c].ptr = b & (curType == EMU_PCF85176 ? 0x3f : 0x7f);
+        return;
+    }
+
+    for(i = 0; i < EMU_DEVICES; i++)
+    {
+        d = &emuDev[bus][i];
+        if(d->sa != curSa)
+            continue;
+
+        if((b & 0xf0) == 0xc0)          // Mode set
+        {
+            d->enabled = (b >> 3) & 1;
+            d->bias = (b >> 2) & 1;
+            d->mode = b & 3;
+        }
+        else if((b & 0xf8) == 0xe0)     // Device select
+        {
+            s->counters[c].sub = b & 7;
+        }
+        else if((b & 0xfc) == 0xf8)     // Bank select
+        {
+            d->inBank = (b >> 1) & 1;
+            d->outBank = b & 1;
+        }
+        else if((b & 0xf8) == 0xf0)     // Blink select
+        {
+            d->altBlink = (b >> 2) & 1;
+            d->blink = b & 3;
+        }
+    }
+}
+
+
+// Store one data byte. In static drive mode each bit goes to row 0 (bank
+// 0) or row 2 (bank 1) of successive RAM addresses, MS bit first. When the
+// data pointer runs off the end of RAM, the subaddress counter moves on
+// to the next controller in the cascade.
+static void emuData(int bus, uint8_t b)
+{
+    emuBusState *s = &busState[bus];
+    int bit, i;
+    int c = counterIndex(s->curSa);
+    emuDevice *d;
+
+    for(bit = 7; bit >= 0; bit--)
+    {
+        for(i = 0; i < EMU_DEVICES; i++)
+        {
+            d = &emuDev[bus][i];
+            if(d->sa != s->curSa || d->subaddr != s->counters[c].sub)
+                continue;
+
+            if(s->counters[c].ptr < d->nSegs)
+            {
+                uint8_t row = 1 << (d->inBank ? 2 : 0);
+                if(b & (1 << bit))
+                    d->ram[s->counters[c].ptr] |= row;
+                else
+                    d->ram[s->counters[c].ptr] &= ~row;
+            }
+        }
+
+        if(++s->counters[c].ptr >= (s->curType == EMU_PCF85176 ? 40 : 60))
+        {
+            s->counters[c].ptr = 0;
+            s->counters[c].sub = (s->counters[c].sub + 1) & 7;
+        }
+    }
+}
+
+
+void emuStart(int bus)
+{
+    busState[bus].phase = PH_ADDR;   // A repeated start ends any data run too
+}
+
+
+int emuByte(int bus, uint8_t b)
+{
+    emuBusState *s = &busState[bus];
+    int i;
+
+    switch(s->phase)
+    {
+        case PH_ADDR:
+            for(i = 0; i < EMU_DEVICES; i++)
+            {
+                if(emuDev[bus][i].sa == b)   // Write address (R/W = 0) only
+                {
+                    s->curSa = b;
+                    s->curType = emuDev[bus][i].type;
+                    s->phase = (s->curType == EMU_PCF85176) ? PH_CMD : PH_CTRL;
+                    return 1;
+                }
+            }
+            s->phase = PH_IDLE;
+            return 0;
+
+        case PH_CMD:
+            emuCommand(bus, b & 0x7f);
+            if(!(b & 0x80))
+                s->phase = PH_DATA;   // Last command; data follows
+            return 1;
+
+        case PH_CTRL:
+            if(b & 0x80)   // Co: one byte, then another control byte
+                s->phase = (b & 0x40) ? PH_ONE_DATA : PH_ONE_CMD;
+            else
+                s->phase = (b & 0x40) ? PH_DATA : PH_CMDS;
+            return 1;
+
+        case PH_ONE_CMD:
+            emuCommand(bus, b);
+            s->phase = PH_CTRL;
+            return 1;
+
+        case PH_ONE_DATA:
+            emuData(bus, b);
+            s->phase = PH_CTRL;
+            return 1;
+
+        case PH_CMDS:
+            emuCommand(bus, b);
+            return 1;
+
+        case PH_DATA:
+            emuData(bus, b);
+            return 1;
+
+        default:
+            return 0;   // Not addressed
+    }
+}
+
+
+void emuStop(int bus)
+{
+    busState[bus].phase = PH_IDLE;
+}
+
+
+void emuShownBytes(int bus, int dev, uint8_t seg[8])
+{
+    emuDevice *d = &emuDev[bus][dev];
+    uint8_t row = 1 << (d->outBank ? 2 : 0);
+    int a;
+
+    memset(seg, 0, 8);
+    for(a = 0; a < d->nSegs; a++)
+    {
+        if(d->ram[a] & row)
+            seg[a / 8] |= 0x80 >> (a % 8);
+    }
+}
+
+
+// ---------------------------------------------------------------------
+// Rendering. Glass wiring, per the maps in nxp_lcd_driver.c: segment
+// byte per digit with segments g..a in bits 7..1 and the period in bit 0,
+// plus a byte of commas.
+
+// Render 'n' digits (left to right) into three text rows
+static void renderDigits(char rows[3][64], const uint8_t code[], const uint8_t comma[], int n)
+{
+    int i, col = 0;
+    uint8_t c;
+
+    for(i = 0; i < n; i++)
+    {
+        c = code[i];
+        rows[0][col]   = ' ';
+        rows[0][col+1] = (c & 0x02) ? '_' : ' ';   // a
+        rows[0][col+2] = ' ';
+        rows[1][col]   = (c & 0x40) ? '|' : ' ';   // f
+        rows[1][col+1] = (c & 0x80) ? '_' : ' ';   // g
+        rows[1][col+2] = (c & 0x04) ? '|' : ' ';   // b
+        rows[2][col]   = (c & 0x20) ? '|' : ' ';   // e
+        rows[2][col+1] = (c & 0x10) ? '_' : ' ';   // d
+        rows[2][col+2] = (c & 0x08) ? '|' : ' ';   // c
+        rows[0][col+3] = ' ';
+        rows[1][col+3] = ' ';
+        rows[2][col+3] = (c & 1) ? (comma[i] ? ';' : '.') : (comma[i] ? ',' : ' ');
+        col += 4;
+    }
+    rows[0][col] = rows[1][col] = rows[2][col] = 0;
+}
+
+
+// Do RAM banks 0 and 1 (rows 0 and 2, static mode) hold different data?
+static int banksDiffer(const emuDevice *d)
+{
+    int a;
+
+    for(a = 0; a < d->nSegs; a++)
+        if(((d->ram[a] >> 2) ^ d->ram[a]) & 1)
+            return 1;
+    return 0;
+}
+
+
+// Blink note for a device; alternate bank blinking only shows if the
+// banks differ
+static const char *blinkName(const emuDevice *d)
+{
+    static const char *rate[4] = { "", " [blink 2Hz", " [blink 1Hz", " [blink 0.5Hz" };
+    static char buf[32];
+
+    if(!d->blink || (d->altBlink && !banksDiffer(d)))
+        return "";
+    snprintf(buf, sizeof(buf), "%s%s]", rate[d->blink], d->altBlink ? " alt" : "");
+    return buf;
+}
+
+
+void emuRender(int bus, FILE *f)
+{
+    emuDevice *devs = emuDev[bus];
+    char rows[3][3][64];
+    uint8_t seg[8], code[6], comma[6];
+    int i, r, dev;
+    static const char *lineName[2] = { "L1", "L2" };
+
+    // H4235: top line is subaddress 1 (dev 4), bottom is 0 (dev 3).
+    // Digit 1 (left) is byte 0; commas at S48,49,50 (byte 6, 0xe0)
+    for(i = 0; i < 2; i++)
+    {
+        dev = i == 0 ? 4 : 3;
+        emuShownBytes(bus, dev, seg);
+        for(r = 0; r < 6; r++)
+        {
+            code[r] = seg[r];
+            comma[r] = 0;
+        }
+        comma[2] = (seg[6] & 0x80) != 0;    // Comma after digit 3
+        comma[3] = (seg[6] & 0x40) != 0;
+        comma[4] = (seg[6] & 0x20) != 0;
+        renderDigits(rows[0], code, comma, 6);
+        for(r = 0; r < 3; r++)
+            fprintf(f, "%s %s%s\n", r == 1 ? lineName[i] : "  ", rows[0][r],
+                    (r == 1) ? (devs[dev].enabled ? blinkName(&devs[dev]) : " [off]") : "");
+    }
+
+    // H4198s, side by side. Digit 4 (left) is byte 3; commas at
+    // S37,38,39 (byte 4, 0x07)
+    for(i = 0; i < 3; i++)
+    {
+        emuShownBytes(bus, i, seg);
+        for(r = 0; r < 4; r++)
+            code[r] = seg[3 - r];
+        comma[0] = (seg[4] & 0x01) != 0;    // Comma after digit 4
+        comma[1] = (seg[4] & 0x02) != 0;
+        comma[2] = (seg[4] & 0x04) != 0;
+        comma[3] = 0;
+        renderDigits(rows[i], code, comma, 4);
+    }
+    for(r = 0; r < 3; r++)
+        fprintf(f, "%s %-17s %-17s %-17s\n", r == 1 ? "S " : "  ",
+                rows[0][r], rows[1][r], rows[2][r]);
+    for(i = 0; i < 3; i++)
+        if(*blinkName(&devs[i]) || !devs[i].enabled)
+            fprintf(f, "   S%d%s\n", i + 1, devs[i].enabled ? blinkName(&devs[i]) : " [off]");
+}
@@ -0,0 +1,67 @@
+#ifndef _NXP_EMU_H_
+#define _NXP_EMU_H_
+
+// nxp_emu
+//
+// Software model of the NXP PCF85176 (40 segment) and PCF85134 (60
+// segment) LCD controllers, wired as on the LXD demo board:
+//
+//   0x70  3 x PCF85176, subaddresses 0..2   (H4198 left, middle, right)
+//   0x72  2 x PCF85134, subaddresses 0..1   (H4235 bottom, top line)
+//
+// The model takes the raw bytes seen on the bus (from host/lcd_bus_host.c)
+// and executes the command set: mode set, load data pointer, device
+// select, bank select and blink select, plus display RAM writes with the
+// data pointer / subaddress counter behaviour of a cascade. Only static
+// drive mode (the one we use) is modelled for RAM writes.
+//
+// Commands other than load data pointer and device select are taken by
+// every controller at the slave address, as on the real parts.
+//
+// There's one such board per bus (lcd_bus.h), each with its own state.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lcd_bus.h"
+
+#define EMU_PCF85176   0
+#define EMU_PCF85134   1
+
+#define EMU_DEVICES    5
+
+typedef struct
+{
+    uint8_t  type;        // EMU_PCF85176 / EMU_PCF85134
+    uint8_t  sa;          // I2C slave address (8 bit form, R/W = 0)
+    uint8_t  subaddr;     // Hardware subaddress (A2..A0 pins)
+    uint8_t  nSegs;       // RAM addresses: 40 or 60
+    uint8_t  enabled;     // Mode set E bit
+    uint8_t  mode;        // Mode set M1,M0 (1 = static)
+    uint8_t  bias;        // Mode set B bit
+    uint8_t  inBank;      // Input bank (static: 0 = RAM row 0, 1 = row 2)
+    uint8_t  outBank;     // Output bank
+    uint8_t  blink;       // Blink frequency, BF1,BF0 (0 = off)
+    uint8_t  altBlink;    // AB bit: blink by alternating RAM banks
+    uint8_t  ram[64];     // 4 bits (rows 0..3) per RAM address
+} emuDevice;
+
+extern emuDevice emuDev[LCD_MAX_BUSES][EMU_DEVICES];   // Per bus
+
+// Power-on reset of all the controllers on a bus
+void emuReset(int bus);
+
+// Bus side: start condition, one byte (returns 1 for ACK, 0 for NACK),
+// stop condition.
+void emuStart(int bus);
+int  emuByte(int bus, uint8_t b);
+void emuStop(int bus);
+
+// Segment bytes currently displayed by controller 'dev' (output bank),
+// packed as the driver sends them: bit 7 of byte k is RAM address 8k.
+void emuShownBytes(int bus, int dev, uint8_t seg[8]);
+
+// ASCII-art seven segment rendering of the demo board's glass (on 'bus')
+void emuRender(int bus, FILE *f);
+
+#endif
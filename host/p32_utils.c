@@ -0,0 +1,59 @@
+//
+// p32_utils (host)
+//
+// LXD Research & Display
+//
+// Host versions of the ../common/p32_utils.c delays, and the virtual
+// clock. See p32_utils.h.
+//
+
+#include <stdint.h>
+
+#include "p32_utils.h"
+#include "lcd_bus.h"
+#include "lcd_bus_host.h"
+#include "sched.h"
+#include "pulser_host.h"
+
+
+uint64_t hostClockNs;
+
+
+// hostAdvance - Let virtual time pass, ticking the scheduler for each
+//               millisecond boundary crossed (the Timer1 interrupt), and
+//               delivering the pulser edges that fell due (the capture
+//               interrupt)
+//
+void hostAdvance(uint64_t ns)
+{
+    uint64_t ms = hostClockNs / 1000000;
+
+    hostClockNs += ns;
+    for(; ms < hostClockNs / 1000000; ms++)
+        schedTick();
+    hostPulser(hostClockNs);
+}
+
+
+// Stand-in for the I2C interrupts, on every bus
+static void pollBuses(void)
+{
+    int bus;
+
+    for(bus = 0; bus < LCD_MAX_BUSES; bus++)
+        busPoll(bus);
+}
+
+
+void delay_ms(int ms)
+{
+    pollBuses();
+    hostAdvance((uint64_t)ms * 1000000);
+}
+
+
+void delay_us(int us)
+{
+    pollBuses();
+    hostAdvance((uint64_t)us * 1000);
+}
@@ -0,0 +1,13 @@
+#ifndef _P32_UTILS_H_
+#define _P32_UTILS_H_
+
+// p32_utils (host)
+//
+// Host stand-in for ../common/p32_utils.h. The delays don't sleep; they
+// advance the virtual clock (hostClockNs, which also drives the
+// scheduler tick) and let the emulated bus run.
+
+void delay_ms(int ms);
+void delay_us(int us);
+
+#endif
@@ -0,0 +1,65 @@
+//
+// pulser_host
+//
+// LXD Research & Display
+//
+// Linux host backend for pulser.h; see pulser_host.h. The capture timer
+// runs at pbClk / 8, as Timer2/3 does on the board, and is worked out
+// from the virtual clock.
+//
+
+#include <stdint.h>
+
+#include "pulser.h"
+#include "pulser_host.h"
+#include "lcd_bus_host.h"
+
+
+static uint32_t tickHz;
+static uint32_t tickNs;        // ns per tick
+static uint64_t periodNs;      // 0 = pulser stopped
+static uint64_t nextEdgeNs;
+
+
+static uint32_t stampAt(uint64_t ns)
+{
+    return (uint32_t)(ns / tickNs);
+}
+
+
+uint32_t pulserInit(int pbClk)
+{
+    tickHz = pbClk / 8;
+    tickNs = 1000000000 / tickHz;
+    return tickHz;
+}
+
+
+uint32_t pulserNow(void)
+{
+    if(tickNs == 0)
+        return 0;
+    return stampAt(hostClockNs);
+}
+
+
+uint32_t pulserOverruns(void)
+{
+    return 0;   // Edges are delivered as they fall due; none are dropped
+}
+
+
+void hostPulserRate(uint32_t pulsesPerMinute)
+{
+    periodNs = pulsesPerMinute ? 60000000000ULL / pulsesPerMinute : 0;
+    nextEdgeNs = hostClockNs + periodNs;
+}
+
+
+void hostPulser(uint64_t nowNs)
+{
+    if(periodNs == 0 || tickNs == 0)
+        return;
+    for(; nextEdgeNs <= nowNs; nextEdgeNs += periodNs)
+        flowEdge(stampAt(nextEdgeNs));
+}
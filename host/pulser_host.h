@@ -0,0 +1,22 @@
+#ifndef _PULSER_HOST_H_
+#define _PULSER_HOST_H_
+
+// pulser_host
+//
+// Host (Linux) backend for pulser.h: a simulated pulser, giving edges at
+// a steady rate on the virtual clock (hostClockNs). hostAdvance() runs
+// it, so edges arrive whenever time passes - in the middle of an
+// i2cWait() as much as between display updates - as the capture
+// interrupt would deliver them.
+
+#include <stdint.h>
+
+// Set the pulser's rate, in pulses per minute (0 stops it). The first
+// edge at a new rate comes one period after the call.
+void hostPulserRate(uint32_t pulsesPerMinute);
+
+// Deliver the edges due by the virtual time now (ns). Called by
+// hostAdvance().
+void hostPulser(uint64_t nowNs);
+
+#endif
@@ -0,0 +1,294 @@
+//
+// trace_dec
+//
+// LXD Research & Display
+//
+// Decodes an I2C trace dump (i2c_trace.h), as sent by the board or
+// written by host_demo -t: each transaction's bytes are played into the
+// controller emulator (nxp_emu.c), as far as they reached the bus, so
+// what's left at the end is what each controller's segment RAM held,
+// and the glass it made. Then, per bus, how busy it was over the time
+// the trace covers.
+//
+// The emulator starts from power-on reset, so a trace taken from start
+// up (nxpInit()'s writes included) gives the whole picture; one joined
+// part way gives only the RAM written since, with the rest blank.
+//
+// -v lists the transactions as they go, with the NXP commands named.
+//
+// Usage: trace_dec [-v] [file]   (standard input if no file)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "lcd_bus.h"
+#include "i2c_master.h"
+#include "nxp_emu.h"
+
+
+typedef struct
+{
+    int      seen;
+    uint32_t lastStart;      // Trace time of the record before
+    uint64_t t;              // Its start, in ticks from the bus's first record
+    uint64_t end;            // Latest stop, likewise
+    uint64_t busy;           // Ticks with a transaction on the bus
+    uint32_t records, failed, bytes, dropped;
+} busTrace;
+
+static busTrace buses[LCD_MAX_BUSES];
+static int verbose;
+static int inData;           // Listing: the last thing out was data
+
+#define TICKS_PER_MS  (BUS_TICKS_PER_US * 1000.0)
+
+
+static const char *statusName(int status)
+{
+    static const char *name[] =
+    {
+        "ok", "start", "send addr", "nack addr", "send data", "nack data",
+        "queue full", "length", "stale", "timeout", "bus stuck"
+    };
+
+    return status < (int)(sizeof(name) / sizeof(name[0])) ? name[status] : "?";
+}
+
+
+// Name one command; type as nxp_emu.h. The PCF85176's continuation bit
+// is dropped, so both types' opcodes line up (as emuCommand() does).
+static void commandOut(uint8_t b, int type)
+{
+    static const char *mode[4] = { "1:4", "static", "1:2", "1:3" };
+    static const char *blink[4] = { "off", "2Hz", "1Hz", "0.5Hz" };
+
+    inData = 0;
+    if(type == EMU_PCF85176)
+        b |= 0x80;
+
+    if(!(b & 0x80) || (type == EMU_PCF85176 && !(b & 0x40)))
+        printf(" ptr %u", b & (type == EMU_PCF85176 ? 0x3f : 0x7f));
+    else if((b & 0xf0) == 0xc0)
+        printf(" mode %s %s", (b & 0x08) ? "on" : "off", mode[b & 3]);
+    else if((b & 0xf8) == 0xe0)
+        printf(" dev %u", b & 7);
+    else if((b & 0xfc) == 0xf8)
+        printf(" bank in %u out %u", (b >> 1) & 1, b & 1);
+    else if((b & 0xf8) == 0xf0)
+        printf(" blink %s%s", blink[b & 3], (b & 0x04) ? " alt" : "");
+    else
+        printf(" ?%02x", b);
+}
+
+
+static void dataOut(const uint8_t *p, int n)
+{
+    if(!inData)
+        printf(" |");
+    inData = 1;
+    while(n--)
+        printf(" %02x", *p++);
+}
+
+
+// List a transaction's commands and data, split as the controllers
+// would split them (see nxp_emu.c). Data runs start with a "|".
+static void decodeOut(uint8_t sa, const uint8_t *p, int n)
+{
+    int i = 0, ctrl;
+
+    inData = 0;
+    if(sa == 0x70)                               // PCF85176: C bit per command
+    {
+        while(i < n)
+        {
+            commandOut(p[i] & 0x7f, EMU_PCF85176);
+            if(!(p[i++] & 0x80))
+                break;
+        }
+        if(i < n)
+            dataOut(&p[i], n - i);
+        return;
+    }
+    if(sa != 0x72)
+    {
+        dataOut(p, n);
+        return;
+    }
+
+    while(i < n)                                 // PCF85134: control bytes
+    {
+        ctrl = p[i++];
+        if(!(ctrl & 0x80))                       // Co clear: the rest is all one
+        {
+            if(ctrl & 0x40)
+                dataOut(&p[i], n - i);
+            else
+                for(; i < n; i++)
+                    commandOut(p[i], EMU_PCF85134);
+            return;
+        }
+        if(i < n && (ctrl & 0x40))
+            dataOut(&p[i++], 1);
+        else if(i < n)
+            commandOut(p[i++], EMU_PCF85134);
+    }
+}
+
+
+// A transaction record
+static void record(int bus, uint32_t start, uint32_t ticks, uint8_t sa,
+                   int status, int sent, const uint8_t *data, int n)
+{
+    busTrace *b = &buses[bus];
+    int i, reached;
+
+    if(!b->seen)
+    {
+        b->seen = 1;
+        b->lastStart = start;
+    }
+    b->t += (int32_t)(start - b->lastStart);     // The timer wraps; deltas don't
+    b->lastStart = start;
+    if(b->t + ticks > b->end)
+        b->end = b->t + ticks;
+    b->busy += ticks;
+    b->records++;
+    if(status != I2C_OK)
+        b->failed++;
+
+    // Bytes the controllers took: a byte the transmitter refused, or the
+    // slave NACK'd, never got there
+    reached = sent;
+    if(status == I2C_ERR_SEND_DATA || status == I2C_ERR_NACK_DATA)
+        reached--;
+    if(status == I2C_ERR_START || status == I2C_ERR_SEND_ADDR || status == I2C_ERR_NACK_ADDR)
+        reached = -1;
+    if(reached >= 0)
+    {
+        emuStart(bus);
+        emuByte(bus, sa);
+        for(i = 0; i < reached && i < n; i++)
+            emuByte(bus, data[i]);
+        emuStop(bus);
+        b->bytes += reached + 1;
+    }
+
+    if(verbose)
+    {
+        printf("%10.3f ms  bus %d  %02x  %-9s %5.1f us ", b->t / TICKS_PER_MS, bus, sa,
+               statusName(status), ticks / (double)BUS_TICKS_PER_US);
+        decodeOut(sa, data, sent < n ? sent : n);
+        if(sent < n)
+            printf("  (%d of %d sent)", sent, n);
+        printf("\n");
+    }
+}
+
+
+// Segment bytes in a controller's RAM bank, packed as emuShownBytes()
+static void bankBytes(const emuDevice *d, int bank, uint8_t seg[8])
+{
+    uint8_t row = 1 << (bank ? 2 : 0);
+    int a;
+
+    memset(seg, 0, 8);
+    for(a = 0; a < d->nSegs; a++)
+        if(d->ram[a] & row)
+            seg[a / 8] |= 0x80 >> (a % 8);
+}
+
+
+static void busReport(int bus)
+{
+    static const char *devName[EMU_DEVICES] = { "S1", "S2", "S3", "L2", "L1" };
+    static const char *mode[4] = { "1:4", "static", "1:2", "1:3" };
+    busTrace *b = &buses[bus];
+    const emuDevice *d;
+    uint8_t seg[8];
+    int dev, bank, i;
+
+    printf("--- bus %d: %u transactions, %u failed, %u dropped, %u bytes\n",
+           bus, b->records, b->failed, b->dropped, b->bytes);
+    printf("busy %.3f ms of %.3f ms (%.1f%%)\n", b->busy / TICKS_PER_MS, b->end / TICKS_PER_MS,
+           b->end ? b->busy * 100.0 / b->end : 0.0);
+    if(b->dropped)
+        printf("(records were dropped: the RAM below may be missing writes)\n");
+
+    for(dev = 0; dev < EMU_DEVICES; dev++)
+    {
+        d = &emuDev[bus][dev];
+        printf("%s %02x/%u %-3s %-6s in %u out %u blink %u%s ", devName[dev], d->sa, d->subaddr,
+               d->enabled ? "on" : "off", mode[d->mode], d->inBank, d->outBank, d->blink,
+               d->altBlink ? " alt" : "    ");
+        for(bank = 0; bank < 2; bank++)
+        {
+            bankBytes(d, bank, seg);
+            printf(" bank %d:", bank);
+            for(i = 0; i < (d->nSegs + 7) / 8; i++)
+                printf(" %02x", seg[i]);
+        }
+        printf("\n");
+    }
+    emuRender(bus, stdout);
+}
+
+
+int main(int argc, char *argv[])
+{
+    char line[512];
+    uint8_t data[I2C_MAX_XFER];
+    unsigned bus, start, ticks, sa, status, sent, count, v;
+    int opt, n, pos, k, bad = 0;
+    FILE *f = stdin;
+    char *p;
+
+    while((opt = getopt(argc, argv, "v")) != -1)
+    {
+        switch(opt)
+        {
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-v] [file]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(optind < argc && !(f = fopen(argv[optind], "r")))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    for(bus = 0; bus < LCD_MAX_BUSES; bus++)
+        emuReset(bus);
+
+    while(fgets(line, sizeof(line), f))
+    {
+        if(sscanf(line, "T%x %x %x %x %x %x %n", &bus, &start, &ticks, &sa, &status, &sent, &pos) == 6 &&
+           bus < LCD_MAX_BUSES)
+        {
+            for(n = 0, p = &line[pos]; n < I2C_MAX_XFER && sscanf(p, "%2x%n", &v, &k) == 1; n++, p += k)
+                data[n] = v;
+            record(bus, start, ticks, sa, status, sent, data, n);
+        }
+        else if(sscanf(line, "D%x %x", &bus, &count) == 2 && bus < LCD_MAX_BUSES)
+        {
+            buses[bus].dropped = count;
+            if(verbose)
+                printf("bus %u: %u records dropped so far\n", bus, count);
+        }
+        else
+            bad++;
+    }
+
+    for(bus = 0; bus < LCD_MAX_BUSES; bus++)
+        if(buses[bus].seen)
+            busReport(bus);
+    if(bad)
+        printf("%d lines not understood\n", bad);
+    return 0;
+}
@@ -0,0 +1,85 @@
+//
+// uart_host
+//
+// LXD Research & Display
+//
+// Linux host backend for uart.h; see uart_host.h. Both directions are
+// SPSC rings (spsc.h), as the target's transmit queue is: the test is
+// the producer of one and the consumer of the other.
+//
+
+#include <stdint.h>
+
+#include "uart.h"
+#include "uart_host.h"
+#include "spsc.h"
+
+
+SPSC_RING(uartRxRing, uint8_t, UART_RX_RING)
+SPSC_RING(uartTxRing, uint8_t, UART_TX_RING)
+
+static uartRxRing rx;
+static uartTxRing tx;
+static uint32_t   errors;
+
+
+void uartInit(int pbClk, uint32_t baud)
+{
+    (void)pbClk;
+    (void)baud;
+    rx.head = rx.tail = 0;
+    tx.head = tx.tail = 0;
+}
+
+
+int uartRead(uint8_t *buf, int max)
+{
+    int n = 0;
+
+    while(n < max && !uartRxRingGet(&rx, &buf[n]))
+        n++;
+    return n;
+}
+
+
+int uartWrite(const uint8_t *buf, int n)
+{
+    int i;
+
+    if(n > UART_TX_RING - uartTxRingCount(&tx)) return 0;
+    for(i = 0; i < n; i++)
+        uartTxRingPut(&tx, &buf[i]);
+    return n;
+}
+
+
+uint32_t uartErrors(void)
+{
+    return errors;
+}
+
+
+int hostUartFeed(const uint8_t *buf, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        if(uartRxRingPut(&rx, &buf[i]))
+        {
+            errors += n - i;
+            break;
+        }
+    }
+    return i;
+}
+
+
+int hostUartSent(uint8_t *buf, int max)
+{
+    int n = 0;
+
+    while(n < max && !uartTxRingGet(&tx, &buf[n]))
+        n++;
+    return n;
+}
@@ -0,0 +1,21 @@
+#ifndef _UART_HOST_H_
+#define _UART_HOST_H_
+
+// uart_host
+//
+// Host (Linux) backend for uart.h: a UART with the far end played by
+// the test. What it feeds lands in the receive ring at once, as if the
+// DMA had just copied it; what the firmware sends waits for it to
+// collect.
+
+#include <stdint.h>
+
+// Bytes "received". Any that don't fit in the ring are lost (counted by
+// uartErrors()), as a lapped DMA ring would lose them. Returns the
+// number that fitted.
+int hostUartFeed(const uint8_t *buf, int n);
+
+// Collect up to max bytes the firmware has sent. Returns the number.
+int hostUartSent(uint8_t *buf, int max);
+
+#endif
@@ -0,0 +1,454 @@
+//
+// i2c_master
+//
+// LXD Research & Display
+//
+// Interrupt driven I2C master for the NXP LCD controllers. Replaces the
+// old busy-wait nxpRawWrite(), which spun on the I2C status bits for
+// every byte (over 1ms of dead CPU time for one 13 byte H4235 write at
+// 100KHz).
+//
+// Each bus (lcd_bus.h) has its own engine (i2cEngine), so the buses run
+// independently. Transactions are held in a small ring (queue[]).
+// Main-line code adds at 'head'; the interrupt retires at 'tail'. Both
+// are free running ticket counters, and a transaction's ticket doubles
+// as its handle (on that bus).
+//
+// Each transaction is walked through these states, one I2C master
+// interrupt per step:
+//
+//    I2C_ST_IDLE_WAIT   Bus wasn't idle; a stop was issued to shake the
+//                       NXPs loose. Retry the start when it completes
+//                       (up to I2C_IDLE_RETRIES times, then busRecover()).
+//    I2C_ST_START       Start done; send the slave address.
+//    I2C_ST_ADDR        Address sent; check ACK, send first data byte.
+//    I2C_ST_DATA        Data byte sent; check ACK, send next or stop.
+//    I2C_ST_STOP        Stop done; complete, and start the next one.
+//
+// Every step is timed from the moment it is issued (stepStart), and
+// i2cService() recovers the bus if one overruns I2C_STEP_TIMEOUT_US, so
+// nothing waits on the bus forever.
+//
+// The hardware itself is behind lcd_bus.h; this file has no PIC32
+// dependencies, so it builds for the host emulator too.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i2c_master.h"
+#include "lcd_bus.h"
+#include "perf_stats.h"
+#include "i2c_trace.h"
+
+
+// Engine states
+#define I2C_ST_IDLE       0
+#define I2C_ST_IDLE_WAIT  1
+#define I2C_ST_START      2
+#define I2C_ST_ADDR       3
+#define I2C_ST_DATA       4
+#define I2C_ST_STOP       5
+
+typedef struct
+{
+    uint8_t      sa;                  // Slave address
+    uint8_t      n;                   // Number of data bytes
+    uint8_t      data[I2C_MAX_XFER];  // Data bytes
+    i2cCallback  done;                // Completion callback, or 0
+    void        *ctx;                 // Callback context
+    i2cHandle    ticket;              // Handle of the transaction in this slot
+    volatile int status;              // I2C_PENDING until complete
+    PERF_VAR(tQueued)                 // Core timer at i2cSubmit()
+} i2cXfer;
+
+typedef struct
+{
+    i2cXfer queue[I2C_QUEUE_DEPTH];
+    volatile i2cHandle head;      // Next ticket to hand out
+    volatile i2cHandle tail;      // Ticket on the bus (or next to go)
+    volatile uint8_t state;       // I2C_ST_xxx
+    volatile uint8_t pos;         // Next data byte to send
+    volatile int xferStatus;      // Result so far for the transaction on the bus
+    volatile uint32_t errorCount; // Transactions that failed
+    volatile uint32_t xferCount;  // Transactions completed
+    volatile uint32_t nackCount;  // Transactions that failed on a NACK
+    volatile uint32_t newSpeed;   // SCL rate to switch to at the next start, or 0
+    uint32_t speed;               // SCL rate in use
+    volatile uint32_t stepStart;  // busNow() when the current step was issued
+    uint8_t idleRetries;          // Stops tried on a busy bus, this transaction
+    PERF_VAR(tStart)              // Core timer when the one on the bus (or stalled) began
+    TRACE_VAR(traceStart)         // busNow() likewise, for the trace
+} i2cEngine;
+
+static i2cEngine engines[LCD_MAX_BUSES];   // By bus number
+
+
+static void i2cKick(int bus);
+static void i2cComplete(int bus);
+static void i2cTimeout(int bus);
+
+
+// i2cInit
+//
+// Reset the bus's queue, and bring up the bus (see busInit()).
+//
+uint32_t i2cInit(int bus, int pbClk, uint32_t sclHz)
+{
+    i2cEngine *e;
+
+    if(bus < 0 || bus >= LCD_MAX_BUSES)
+        return 0;
+    e = &engines[bus];
+    e->head = e->tail = 0;
+    e->state = I2C_ST_IDLE;
+    e->newSpeed = 0;
+
+    e->speed = busInit(bus, pbClk, sclHz);
+    return e->speed;
+}
+
+
+// i2cSetSpeed - Change the SCL rate (see i2c_master.h)
+//
+// The rate can only change between transactions, so if one is under
+// way this leaves it to i2cKick().
+//
+void i2cSetSpeed(int bus, uint32_t sclHz)
+{
+    i2cEngine *e = &engines[bus];
+
+    busIntEnable(bus, 0);
+    if(e->state == I2C_ST_IDLE)
+    {
+        e->speed = busSetSpeed(bus, sclHz);
+        e->newSpeed = 0;
+    }
+    else
+        e->newSpeed = sclHz;
+    busIntEnable(bus, 1);
+}
+
+
+uint32_t i2cSpeed(int bus)
+{
+    return engines[bus].speed;
+}
+
+
+// i2cSubmit - Queue a write transaction (see i2c_master.h)
+//
+int i2cSubmit(int bus, uint8_t sa, const uint8_t data[], int n,
+              i2cCallback done, void *ctx, i2cHandle *handle)
+{
+    i2cEngine *e = &engines[bus];
+    i2cXfer *x;
+    i2cHandle ticket;
+
+    if(n < 1 || n > I2C_MAX_XFER)
+        return I2C_ERR_LENGTH;
+    i2cService(bus);
+    if(e->head - e->tail >= I2C_QUEUE_DEPTH)
+        return I2C_ERR_QUEUE_FULL;
+
+    ticket = e->head;
+    x = &e->queue[ticket % I2C_QUEUE_DEPTH];
+    x->sa = sa;
+    x->n = n;
+    memcpy(x->data, data, n);
+    x->done = done;
+    x->ctx = ctx;
+    x->ticket = ticket;
+    x->status = I2C_PENDING;
+    PERF_MARK(x->tQueued);
+    if(handle) *handle = ticket;
+
+    // Publish the slot, then start the bus if the interrupt has gone
+    // quiet. The interrupt can't run part-way through this check on a
+    // single core; if it retires the last transaction just before it,
+    // we see I2C_ST_IDLE and kick; if just after, it sees the new head.
+    e->head = ticket + 1;
+    if(e->state == I2C_ST_IDLE)
+    {
+        busIntEnable(bus, 0);
+        if(e->state == I2C_ST_IDLE)
+            i2cKick(bus);
+        busIntEnable(bus, 1);
+    }
+    return 0;
+}
+
+
+// i2cPoll - Status of a queued transaction
+//
+int i2cPoll(int bus, i2cHandle handle)
+{
+    i2cXfer *x = &engines[bus].queue[handle % I2C_QUEUE_DEPTH];
+
+    if(x->ticket == handle)
+        return x->status;
+    if(handle == I2C_HANDLE_NONE)
+        return I2C_OK;
+    return I2C_ERR_STALE;
+}
+
+
+// i2cWait - Block until a queued transaction completes
+//
+int i2cWait(int bus, i2cHandle handle)
+{
+    int status;
+
+    while((status = i2cPoll(bus, handle)) == I2C_PENDING)
+    {
+        busPoll(bus);
+        i2cService(bus);
+    }
+    return status;
+}
+
+
+// i2cService - Enforce the bus step time limit (see i2c_master.h)
+//
+void i2cService(int bus)
+{
+    i2cEngine *e = &engines[bus];
+
+    if(e->state == I2C_ST_IDLE)
+        return;
+
+    busIntEnable(bus, 0);
+    if(e->state != I2C_ST_IDLE &&
+       busNow() - e->stepStart > I2C_STEP_TIMEOUT_US * BUS_TICKS_PER_US)
+        i2cTimeout(bus);
+    busIntEnable(bus, 1);
+}
+
+
+int i2cPending(int bus)
+{
+    return engines[bus].head - engines[bus].tail;
+}
+
+
+uint32_t i2cErrorCount(int bus)
+{
+    return engines[bus].errorCount;
+}
+
+
+uint32_t i2cXferCount(int bus)
+{
+    return engines[bus].xferCount;
+}
+
+
+uint32_t i2cNackCount(int bus)
+{
+    return engines[bus].nackCount;
+}
+
+
+// i2cKick
+//
+// Begin the transaction at 'tail'. Called with bus events masked (from
+// i2cSubmit), or from the bus event handler itself.
+//
+static void i2cKick(int bus)
+{
+    i2cEngine *e = &engines[bus];
+
+    e->xferStatus = I2C_OK;
+    e->pos = 0;
+    e->stepStart = busNow();
+
+    if(e->state != I2C_ST_IDLE_WAIT)
+    {
+        PERF_END(queueWait, e->queue[e->tail % I2C_QUEUE_DEPTH].tQueued);
+        PERF_MARK(e->tStart);
+        TRACE_MARK(e->traceStart, e->stepStart);
+        e->idleRetries = 0;
+    }
+
+    // If the nxp's get stuck, a stop seems to shake them loose. We'll
+    // be back here when the stop completes. If a few stops don't do it,
+    // clock the bus free (busRecover()).
+    if(!busIsIdle(bus))
+    {
+        PERF_COUNT(idleStalls, 1);
+        if(e->idleRetries < I2C_IDLE_RETRIES)
+        {
+            e->idleRetries++;
+            e->state = I2C_ST_IDLE_WAIT;
+            busStop(bus);
+            return;
+        }
+        PERF_COUNT(busRecoveries, 1);
+        if(busRecover(bus))
+        {
+            e->xferStatus = I2C_ERR_BUS_STUCK;
+            i2cComplete(bus);
+            return;
+        }
+    }
+    if(e->state == I2C_ST_IDLE_WAIT)
+    {
+        PERF_COUNT(stopRecoveries, 1);
+        PERF_END(stall, e->tStart);
+        PERF_MARK(e->tStart);
+    }
+
+    if(e->newSpeed)
+    {
+        e->speed = busSetSpeed(bus, e->newSpeed);
+        e->newSpeed = 0;
+    }
+
+    e->state = I2C_ST_START;
+    if(busStart(bus))
+    {
+        e->xferStatus = I2C_ERR_START;
+        i2cComplete(bus);
+    }
+}
+
+
+// i2cComplete
+//
+// Retire the transaction at 'tail', run its callback, and start the
+// next one (if any).
+//
+static void i2cComplete(int bus)
+{
+    i2cEngine *e = &engines[bus];
+    i2cXfer *x = &e->queue[e->tail % I2C_QUEUE_DEPTH];
+
+    PERF_END(busTime, e->tStart);
+    PERF_COUNT(transactions, 1);
+
+    x->status = e->xferStatus;
+    e->xferCount++;
+    if(e->xferStatus == I2C_ERR_NACK_ADDR || e->xferStatus == I2C_ERR_NACK_DATA)
+        e->nackCount++;
+    if(e->xferStatus != I2C_OK)
+    {
+        e->errorCount++;
+        PERF_COUNT(errors, 1);
+    }
+    TRACE_XFER(bus, e->traceStart, x->sa, x->data, x->n, e->pos, e->xferStatus);
+    e->tail++;
+    if(x->done)
+        x->done(x->ticket, e->xferStatus, x->ctx);
+
+    if(e->head != e->tail)
+        i2cKick(bus);
+    else
+        e->state = I2C_ST_IDLE;
+}
+
+
+// i2cTimeout
+//
+// The current step has overrun its budget (lost interrupt, or a device
+// holding the bus). Recover the bus, and fail the transaction. Called
+// with bus events masked.
+//
+static void i2cTimeout(int bus)
+{
+    PERF_COUNT(timeouts, 1);
+    PERF_COUNT(busRecoveries, 1);
+
+    engines[bus].xferStatus = busRecover(bus) ? I2C_ERR_BUS_STUCK : I2C_ERR_TIMEOUT;
+    i2cComplete(bus);
+}
+
+
+// i2cSendNext
+//
+// Common ACK check & next-byte step for the address and data states.
+//
+static void i2cSendNext(int bus, int nackStatus)
+{
+    i2cEngine *e = &engines[bus];
+    i2cXfer *x = &e->queue[e->tail % I2C_QUEUE_DEPTH];
+
+    if(!busAcked(bus))
+    {
+        PERF_COUNT(nacks, 1);
+        e->xferStatus = nackStatus;
+    }
+    else
+    {
+        PERF_COUNT(bytes, 1);
+        if(e->pos < x->n)
+        {
+            e->state = I2C_ST_DATA;
+            if(!busSendByte(bus, x->data[e->pos++]))
+                return;
+            e->xferStatus = I2C_ERR_SEND_DATA;
+        }
+    }
+
+    // Done (or failed): release the bus
+    e->state = I2C_ST_STOP;
+    busStop(bus);
+}
+
+
+// i2cBusEvent
+//
+// Called by the bus backend (from the I2C interrupt, on the PIC32) each
+// time a start, byte or stop completes; steps that bus's state machine.
+//
+void i2cBusEvent(int bus, int event)
+{
+    i2cEngine *e = &engines[bus];
+
+    e->stepStart = busNow();
+
+    if(event == BUS_EV_COLLISION)
+    {
+        // The hardware has already abandoned the transfer, so there's
+        // no stop to wait for.
+        if(e->state != I2C_ST_IDLE)
+        {
+            e->xferStatus = I2C_ERR_START;
+            i2cComplete(bus);
+        }
+        return;
+    }
+
+    switch(e->state)
+    {
+        case I2C_ST_IDLE_WAIT:
+            i2cKick(bus);
+            break;
+
+        case I2C_ST_START:
+            // Send the device slave address (this device is write-only,
+            // so the R/W bit (bit 0) of the slave address is always zero.
+            e->state = I2C_ST_ADDR;
+            if(busSendByte(bus, e->queue[e->tail % I2C_QUEUE_DEPTH].sa))
+            {
+                e->xferStatus = I2C_ERR_SEND_ADDR;
+                e->state = I2C_ST_STOP;
+                busStop(bus);
+            }
+            break;
+
+        case I2C_ST_ADDR:
+            i2cSendNext(bus, I2C_ERR_NACK_ADDR);
+            break;
+
+        case I2C_ST_DATA:
+            i2cSendNext(bus, I2C_ERR_NACK_DATA);
+            break;
+
+        case I2C_ST_STOP:
+            i2cComplete(bus);
+            break;
+
+        default:
+            break;   // Spurious
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef _I2C_MASTER_H_
+#define _I2C_MASTER_H_
+
+// i2c_master
+//
+// Interrupt driven, non-blocking I2C master transaction engine. Callers
+// queue complete write transactions (slave address + data bytes); the
+// I2C master interrupt walks each one through start, address, data and
+// stop, then starts the next queued transaction.
+//
+// Every call takes the bus number (lcd_bus.h); each bus has its own
+// queue, counters and speed, and handles are only meaningful on the bus
+// that issued them.
+
+#include <stdint.h>
+
+#define I2C_QUEUE_DEPTH  8   // Transactions that can be queued at once (per bus)
+#define I2C_MAX_XFER    48   // Max data bytes per transaction (excl. slave address)
+
+// Transaction status codes. Zero is success; the positive values keep the
+// numbering nxpRawWrite() has always returned.
+#define I2C_PENDING        -1  // Queued, or on the bus now
+#define I2C_OK              0
+#define I2C_ERR_START       1  // Start failed (bus collision / arbitration loss)
+#define I2C_ERR_SEND_ADDR   2  // Transmitter refused the slave address byte
+#define I2C_ERR_NACK_ADDR   3  // Slave address not acknowledged
+#define I2C_ERR_SEND_DATA   4  // Transmitter refused a data byte
+#define I2C_ERR_NACK_DATA   5  // Data byte not acknowledged
+#define I2C_ERR_QUEUE_FULL  6  // No free queue slot
+#define I2C_ERR_LENGTH      7  // Too many (or no) data bytes
+#define I2C_ERR_STALE       8  // Handle's queue slot has since been reused
+#define I2C_ERR_TIMEOUT     9  // A bus step overran its budget; bus recovered
+#define I2C_ERR_BUS_STUCK  10  // Bus held low; recovery couldn't free it
+
+// Time limits. No bus step (start, byte or stop) may take longer than
+// I2C_STEP_TIMEOUT_US; a byte is 90us at 100KHz, and the NXPs never
+// stretch the clock. A bus found busy is given I2C_IDLE_RETRIES stops to
+// come free before the full recovery (busRecover()) is tried.
+//
+// So, worst case, a transaction of n data bytes is done (ok or not)
+// within (n + 3 + I2C_IDLE_RETRIES) step budgets plus one busRecover(),
+// once it reaches the head of the queue - provided i2cService() (or
+// i2cWait()) is being called. About 15ms for a full H4235 write.
+#define I2C_STEP_TIMEOUT_US  1000
+#define I2C_IDLE_RETRIES        3
+
+
+// A handle identifies one queued transaction, for i2cPoll()/i2cWait().
+typedef uint32_t i2cHandle;
+
+// Handle for "nothing needed sending"; polls as I2C_OK.
+#define I2C_HANDLE_NONE  0xffffffffUL
+
+// Completion callback. NOTE: Called from the I2C interrupt; keep it short.
+typedef void (*i2cCallback)(i2cHandle handle, int status, void *ctx);
+
+
+// Configure the bus (lcd_bus.h) for master operation at the given SCL
+// rate, and hook up its events. Returns the actual SCL frequency, or 0
+// if there's no such bus.
+uint32_t i2cInit(int bus, int peripheralBusClock, uint32_t sclHz);
+
+// Queue a write transaction. The data bytes are copied, so the caller's
+// buffer may be reused as soon as this returns. Call from main-line code
+// only (not from an interrupt).
+//
+// Returns 0 once queued (and *handle is set, if handle is non-null), or
+// I2C_ERR_QUEUE_FULL / I2C_ERR_LENGTH.
+int i2cSubmit(int bus,                 // Bus to queue it on
+              uint8_t i2c_address,     // Slave address (write; R/W bit = 0)
+              const uint8_t data[],    // Bytes to send after the address
+              int n,                   // Number of data bytes
+              i2cCallback done,        // Optional completion callback (or 0)
+              void *ctx,               // Passed through to the callback
+              i2cHandle *handle);      // Optional; returns the transaction handle
+
+// Status of a queued transaction: I2C_PENDING, I2C_OK or an error code.
+int i2cPoll(int bus, i2cHandle handle);
+
+// Block until a transaction completes; returns its final status.
+// Bounded by the time limits above.
+int i2cWait(int bus, i2cHandle handle);
+
+// Enforce the time limits: if the current bus step has overrun, recover
+// the bus and fail the transaction (I2C_ERR_TIMEOUT). A lost interrupt
+// or a wedged controller otherwise stalls the queue for good. Call from
+// the main loop, for each bus in use; i2cSubmit() and i2cWait() call it
+// too.
+void i2cService(int bus);
+
+// Number of transactions queued or in flight.
+int i2cPending(int bus);
+
+// Running count of transactions that completed with an error.
+uint32_t i2cErrorCount(int bus);
+
+// Running counts of completed transactions, and of those that failed on
+// a NACK (I2C_ERR_NACK_ADDR / I2C_ERR_NACK_DATA).
+uint32_t i2cXferCount(int bus);
+uint32_t i2cNackCount(int bus);
+
+// Change the SCL rate. Takes effect at the start of the next transaction
+// (at once, if the bus is quiet); anything in flight finishes at the old
+// rate.
+void i2cSetSpeed(int bus, uint32_t sclHz);
+
+// The SCL frequency in use (actual, as set by the hardware).
+uint32_t i2cSpeed(int bus);
+
+#endif
@@ -0,0 +1,170 @@
+//
+// i2c_trace
+//
+// LXD Research & Display
+//
+// I2C transaction flight recorder; see i2c_trace.h. Each bus has its
+// own SPSC ring (spsc.h): a bus's transactions only ever complete in its
+// own interrupt, or with that interrupt masked, so each ring has just
+// the one producer, however the bus interrupts are prioritized. Records
+// are filled in place in the ring, and formatted only as they're
+// dumped, from main-line code.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i2c_trace.h"
+#include "lcd_bus.h"
+#include "spsc.h"
+
+#ifdef I2C_TRACE
+
+
+#if I2C_TRACE_BUSES < 1 || I2C_TRACE_BUSES > LCD_MAX_BUSES
+  #error I2C_TRACE_BUSES out of range (1 to LCD_MAX_BUSES)
+#endif
+
+SPSC_RING(i2cTraceRing, i2cTraceRec, I2C_TRACE)
+
+static i2cTraceRing      rings[I2C_TRACE_BUSES];
+static volatile uint32_t dropped[I2C_TRACE_BUSES];
+static uint32_t          reported[I2C_TRACE_BUSES];   // dropped[], as last dumped
+
+
+// i2cTraceAdd
+//
+// The time is taken here, as the transaction completes, so the record
+// costs one busNow() besides the copy.
+//
+void i2cTraceAdd(int bus, uint32_t start, uint8_t sa, const uint8_t *data,
+                 int n, int sent, int status)
+{
+    i2cTraceRec *r;
+
+    if(bus >= I2C_TRACE_BUSES)
+        return;
+    r = i2cTraceRingReserve(&rings[bus]);
+    if(!r)
+    {
+        dropped[bus]++;
+        return;
+    }
+    r->start = start;
+    r->ticks = busNow() - start;
+    r->sa = sa;
+    r->status = status;
+    r->n = n;
+    r->sent = sent;
+    memcpy(r->data, data, n);
+    i2cTraceRingCommit(&rings[bus]);
+}
+
+
+int i2cTraceRead(int bus, i2cTraceRec *rec)
+{
+    i2cTraceRec *r;
+
+    if(bus < 0 || bus >= I2C_TRACE_BUSES)
+        return 1;
+    r = i2cTraceRingPeek(&rings[bus]);
+    if(!r)
+        return 1;
+    *rec = *r;
+    i2cTraceRingPop(&rings[bus]);
+    return 0;
+}
+
+
+uint32_t i2cTraceDropped(int bus)
+{
+    if(bus < 0 || bus >= I2C_TRACE_BUSES)
+        return 0;
+    return dropped[bus];
+}
+
+
+// hex - v as hex, in digits digits (0: as few as it takes). Returns the
+//       end.
+//
+static char *hex(char *p, uint32_t v, int digits)
+{
+    static const char xd[] = "0123456789abcdef";
+
+    if(!digits)
+        for(digits = 1; digits < 8 && v >> (4 * digits); digits++)
+            ;
+    while(digits--)
+        *p++ = xd[(v >> (4 * digits)) & 0xf];
+    return p;
+}
+
+
+int i2cTraceFormat(int bus, const i2cTraceRec *r, char *line)
+{
+    char *p = line;
+    int i;
+
+    *p++ = 'T';
+    p = hex(p, bus, 0);
+    *p++ = ' ';
+    p = hex(p, r->start, 8);
+    *p++ = ' ';
+    p = hex(p, r->ticks, 0);
+    *p++ = ' ';
+    p = hex(p, r->sa, 2);
+    *p++ = ' ';
+    p = hex(p, r->status, 0);
+    *p++ = ' ';
+    p = hex(p, r->sent, 0);
+    *p++ = ' ';
+    for(i = 0; i < r->n; i++)
+        p = hex(p, r->data[i], 2);
+    *p++ = '\n';
+    return p - line;
+}
+
+
+// i2cTraceDump
+//
+// Records are formatted straight from the ring, and only popped once
+// write() has taken their line.
+//
+int i2cTraceDump(int (*write)(const uint8_t *buf, int n))
+{
+    char line[I2C_TRACE_LINE];
+    i2cTraceRec *r;
+    uint32_t d;
+    int bus, n, lines = 0;
+    char *p;
+
+    for(bus = 0; bus < I2C_TRACE_BUSES; bus++)
+    {
+        d = dropped[bus];
+        if(d != reported[bus])
+        {
+            p = line;
+            *p++ = 'D';
+            p = hex(p, bus, 0);
+            *p++ = ' ';
+            p = hex(p, d, 0);
+            *p++ = '\n';
+            if(!write((const uint8_t *)line, p - line))
+                return lines;
+            reported[bus] = d;
+            lines++;
+        }
+
+        while((r = i2cTraceRingPeek(&rings[bus])) != 0)
+        {
+            n = i2cTraceFormat(bus, r, line);
+            if(!write((const uint8_t *)line, n))
+                return lines;
+            i2cTraceRingPop(&rings[bus]);
+            lines++;
+        }
+    }
+    return lines;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _I2C_TRACE_H_
+#define _I2C_TRACE_H_
+
+// i2c_trace
+//
+// Flight recorder for the I2C engine (i2c_master.c): as each transaction
+// completes, its slave address, bytes, outcome and timing go into a ring
+// in RAM, one per bus, for passing on to a debug channel with
+// i2cTraceDump(). host/trace_dec turns a dump back into what each
+// controller's segment RAM held, the digits that made, and how busy
+// the buses were.
+//
+// Recording is a few stores and a copy of the transaction's bytes, from
+// the I2C interrupt; no decoding. The NXP command bytes (mode set,
+// device select, data pointer, bank select, blink) lead the bytes, so
+// the decoder names them. A full ring drops new records (and counts
+// them) rather than overwriting, so a dump always runs on from what
+// was dumped before.
+//
+// Enabled by defining I2C_TRACE (product_config.h) as the ring size, in
+// records (a power of 2). Otherwise the TRACE_xxx macros expand to
+// nothing, and none of this exists. Only buses below I2C_TRACE_BUSES
+// get a ring; the others aren't recorded.
+//
+// Dump lines, all numbers hex, times in core timer ticks (busNow()):
+//
+//   T<bus> <start> <ticks> <sa> <status> <sent> <bytes>
+//           A transaction: when it began (8 digits; incl. waiting on a
+//           busy bus), how long until its stop, slave address, status
+//           (i2c_master.h), how many bytes went to the bus (fewer than
+//           queued if it failed), and the bytes as queued, 2 digits each
+//   D<bus> <count>
+//           Records dropped on the bus so far, when that's changed
+
+#include <stdint.h>
+
+#include "product_config.h"
+#include "i2c_master.h"
+
+#define I2C_TRACE_LINE  (2 * I2C_MAX_XFER + 32)   // Longest dump line, and more
+
+
+#ifdef I2C_TRACE
+
+typedef struct
+{
+    uint32_t start;                  // busNow() as it began
+    uint32_t ticks;                  // Until its stop completed (or it failed)
+    uint8_t  sa;                     // Slave address
+    uint8_t  status;                 // I2C_OK or I2C_ERR_xxx
+    uint8_t  n;                      // Bytes queued
+    uint8_t  sent;                   // Of those, handed to the bus
+    uint8_t  data[I2C_MAX_XFER];
+} i2cTraceRec;
+
+// Record a completed transaction. Called by the engine, from the bus's
+// interrupt (or with it masked).
+void i2cTraceAdd(int bus, uint32_t start, uint8_t sa, const uint8_t *data,
+                 int n, int sent, int status);
+
+// Take the oldest record on a bus. Returns 0, or 1 if there are none
+// (or the bus isn't traced).
+// Main-line code only, as for i2cTraceDump().
+int i2cTraceRead(int bus, i2cTraceRec *rec);
+
+// Format a record as a dump line (with its newline; at most
+// I2C_TRACE_LINE bytes, unterminated). Returns its length.
+int i2cTraceFormat(int bus, const i2cTraceRec *rec, char *line);
+
+// Pass the records, oldest first and bus by bus, to write() as dump
+// lines, one line per call, until they're all gone or write() refuses
+// one (returns 0; that one is kept for next time). uartWrite() will
+// do. Returns the number of lines written. Main-line code only.
+int i2cTraceDump(int (*write)(const uint8_t *buf, int n));
+
+// Records dropped on a bus (its ring was full), since start up.
+uint32_t i2cTraceDropped(int bus);
+
+#define TRACE_VAR(v)          uint32_t v;
+#define TRACE_MARK(v, now)    ((v) = (now))
+#define TRACE_XFER(bus, start, sa, data, n, sent, status) \
+                              i2cTraceAdd(bus, start, sa, data, n, sent, status)
+
+#else
+
+#define TRACE_VAR(v)
+#define TRACE_MARK(v, now)    ((void)0)
+#define TRACE_XFER(bus, start, sa, data, n, sent, status)  ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _LCD_BUS_H_
+#define _LCD_BUS_H_
+
+// lcd_bus
+//
+// The narrow I2C bus interface that the transaction engine (i2c_master.c)
+// runs on. There are two backends, picked at link time:
+//
+//   lcd_bus_p32.c        PIC32 I2C modules (I2C1 on the Duinomite UEXT port)
+//   host/lcd_bus_host.c  Linux host build; a software emulation of the
+//                        PCF85176 & PCF85134 controllers (host/nxp_emu.c)
+//
+// There can be several buses, numbered from 0, each with its own display
+// set; they run independently (and, on the PIC32, at the same time). The
+// backend maps the numbers to I2C modules.
+//
+// The engine runs one bus operation at a time on each bus (start, byte
+// or stop). The backend reports each one's completion by calling
+// i2cBusEvent() - from the I2C interrupt on the PIC32, from busPoll() on
+// the host.
+
+#include <stdint.h>
+
+#include "product_config.h"
+
+// Bus numbers go from 0 to LCD_MAX_BUSES - 1; the backend may have fewer
+// (busInit() says).
+#define LCD_MAX_BUSES     4
+
+// Events passed to i2cBusEvent()
+#define BUS_EV_DONE       0   // Start, byte or stop has completed
+#define BUS_EV_COLLISION  1   // Bus collision / arbitration lost; transfer abandoned
+
+
+// Power up the LCD supply, configure the bus as master at sclHz, and
+// enable bus events. Returns the actual SCL frequency, or 0 if there's
+// no such bus.
+uint32_t busInit(int bus, int peripheralBusClock, uint32_t sclHz);
+
+// Change the SCL rate; only called between transactions. Returns the
+// actual SCL frequency.
+uint32_t busSetSpeed(int bus, uint32_t sclHz);
+
+int  busIsIdle(int bus);                // Non-zero if SDA & SCL are both released
+int  busStart(int bus);                 // Issue a start; 0 if started, non-zero on collision
+int  busSendByte(int bus, uint8_t b);   // Transmit a byte; 0 if the transmitter took it
+int  busAcked(int bus);                 // Non-zero if the last byte sent was ACK'd
+void busStop(int bus);                  // Issue a stop
+void busIntEnable(int bus, int on);     // Mask (0) / unmask (1) bus events, collisions too
+void busPoll(int bus);                  // Deliver bus events that don't come by interrupt
+
+// Free running timer for the engine's time limits (the core timer on the
+// PIC32; wraps), at BUS_TICKS_PER_US. One for all buses.
+uint32_t busNow(void);
+#define BUS_TICKS_PER_US  (CPU_HZ / 2000000)
+
+// Bus recovery, for a slave left holding SDA (e.g. reset part way
+// through a byte): take the pins from the I2C module, clock SCL until
+// SDA is released (up to 9 pulses), generate a stop by hand, then
+// re-enable the module with bus events cleared. Returns 0 if the bus is
+// idle afterwards, non-zero if SDA or SCL is still held low.
+int busRecover(int bus);
+
+
+// Implemented by the engine (i2c_master.c)
+void i2cBusEvent(int bus, int event);
+
+#endif
@@ -0,0 +1,285 @@
+//
+// lcd_bus_p32
+//
+// LXD Research & Display
+//
+// PIC32 backend for lcd_bus.h: the plib I2C calls, and the I2C master
+// interrupts, for the I2C modules the LCDs hang off.
+//
+
+#include <p32xxxx.h>
+#include <plib.h>
+
+#include "product_config.h"
+#include "lcd_bus.h"
+#include "cpu_load.h"
+#include "p32_utils.h"
+
+
+// The I2C modules the LCD buses are on, by bus number. busRecover()
+// takes the pins back as plain port pins, so they're here too.
+typedef struct
+{
+    I2C_MODULE  module;
+    INT_VECTOR  vector;
+    INT_SOURCE  intM;        // Master event interrupt
+    INT_SOURCE  intB;        // Bus collision interrupt
+    IoPortId    port;        // Port with SCL & SDA (for busRecover)
+    uint32_t    sclBit;
+    uint32_t    sdaBit;
+} busPort;
+
+#if defined GILBARCO_DUINOMITE
+static const busPort ports[] =
+{
+    // 0: UEXT connector. SCL1 is RD10, SDA1 is RD9.
+    { I2C1, INT_I2C_1_VECTOR, INT_I2C1M, INT_I2C1B, IOPORT_D, BIT_10, BIT_9 },
+    // 1: Second display set. The 100 pin part has I2C2: SCL2 is RA2,
+    //    SDA2 is RA3. The 64 pin one (the Duinomite's 795F512H) hasn't,
+    //    so it's I2C3: SCL3 is RF8, SDA3 is RF2 - UART1's pins, so no
+    //    UART1 with a second set.
+#if defined __32MX795F512L__
+    { I2C2, INT_I2C_2_VECTOR, INT_I2C2M, INT_I2C2B, IOPORT_A, BIT_2, BIT_3 },
+  #define BUS1_VECTOR  _I2C_2_VECTOR
+#else
+    { I2C3, INT_I2C_3_VECTOR, INT_I2C3M, INT_I2C3B, IOPORT_F, BIT_8, BIT_2 },
+  #define BUS1_VECTOR  _I2C_3_VECTOR
+#endif
+};
+#else
+  #error need a product defined
+#endif
+
+#define NPORTS  ((int)(sizeof(ports) / sizeof(ports[0])))
+
+static int busPbClk;   // Peripheral bus clock, for busSetSpeed()
+
+
+// busInit
+//
+// Switch on the LCD supply (bus 0), set up the I2C module as a master at
+// sclHz, and enable its master and bus-collision interrupts (both share
+// the module's vector).
+//
+uint32_t busInit(int bus, int pbClk, uint32_t sclHz)
+{
+    const busPort *p;
+    uint32_t actualFreq;
+
+    if(bus < 0 || bus >= NPORTS)
+        return 0;
+    p = &ports[bus];
+
+#if defined GILBARCO_DUINOMITE
+    // 3.3v on UEXT is switched by RB13
+    if(bus == 0)
+    {
+        TRISBCLR = BIT_13;  // Set RB13 as output
+        LATBCLR = BIT_13;   // Low to enable 3.3v
+    }
+#else
+  #error define a product...
+#endif
+
+    busPbClk = pbClk;
+    I2CConfigure(p->module, 0 /*I2C_ENABLE_SLAVE_CLOCK_STRETCHING | I2C_ENABLE_HIGH_SPEED*/);
+    actualFreq = I2CSetFrequency(p->module, pbClk, sclHz);
+    //I2CSetSlaveAddress(...   not needed if we're master only)
+    I2CEnable(p->module, TRUE);
+
+    INTSetVectorPriority(p->vector, INT_PRIORITY_LEVEL_3);
+    INTSetVectorSubPriority(p->vector, INT_SUB_PRIORITY_LEVEL_0);
+    INTClearFlag(p->intM);
+    INTClearFlag(p->intB);
+    INTEnable(p->intM, INT_ENABLED);
+    INTEnable(p->intB, INT_ENABLED);
+
+    return actualFreq;
+}
+
+
+// busSetSpeed
+//
+// The baud rate generator can only be reloaded with the module off.
+//
+uint32_t busSetSpeed(int bus, uint32_t sclHz)
+{
+    uint32_t actualFreq;
+
+    I2CEnable(ports[bus].module, FALSE);
+    actualFreq = I2CSetFrequency(ports[bus].module, busPbClk, sclHz);
+    I2CEnable(ports[bus].module, TRUE);
+
+    return actualFreq;
+}
+
+
+int busIsIdle(int bus)
+{
+    return I2CBusIsIdle(ports[bus].module);
+}
+
+
+int busStart(int bus)
+{
+    // MAGIC ALERT! Without this dummy status read the start never
+    // completes (see nxp_lcd_driver.c notes on the 'mx795).
+    (void)I2CGetStatus(ports[bus].module);
+
+    // Returns either success or I2C_MASTER_BUS_COLLISION
+    return I2CStart(ports[bus].module) != I2C_SUCCESS;
+}
+
+
+int busSendByte(int bus, uint8_t b)
+{
+    return I2CSendByte(ports[bus].module, b) != I2C_SUCCESS;
+}
+
+
+int busAcked(int bus)
+{
+    return I2CByteWasAcknowledged(ports[bus].module);
+}
+
+
+void busStop(int bus)
+{
+    I2CStop(ports[bus].module);
+}
+
+
+// busIntEnable
+//
+// Both of the module's sources: a collision completes the transaction
+// too (i2cBusEvent()), so masking only the master event would let it
+// complete one under the engine's feet.
+//
+void busIntEnable(int bus, int on)
+{
+    INTEnable(ports[bus].intM, on ? INT_ENABLED : INT_DISABLED);
+    INTEnable(ports[bus].intB, on ? INT_ENABLED : INT_DISABLED);
+}
+
+
+void busPoll(int bus)
+{
+    // Nothing to do; events come from the interrupts below.
+}
+
+
+uint32_t busNow(void)
+{
+    return _CP0_GET_COUNT();
+}
+
+
+// Pin helpers for busRecover(). The latch is left low, and a pin is
+// driven low by making it an output, or let go (the pull-up takes it
+// high) by making it an input: open drain, without the ODC register,
+// which isn't in the plib port API.
+static void pinLow(const busPort *p, uint32_t bit)
+{
+    PORTClearBits(p->port, bit);
+    PORTSetPinsDigitalOut(p->port, bit);
+}
+
+
+static void pinRelease(const busPort *p, uint32_t bit)
+{
+    PORTSetPinsDigitalIn(p->port, bit);
+}
+
+
+// busRecover - Free a bus held by a slave (see lcd_bus.h)
+//
+// With the module off, the pins fall back to the port. A slave still
+// holding SDA can't be fought, as we only ever pull low. Clock pulses
+// and the stop are at roughly 100KHz.
+//
+int busRecover(int bus)
+{
+    const busPort *p = &ports[bus];
+    int i;
+    int stuck;
+
+    I2CEnable(p->module, FALSE);
+
+    pinRelease(p, p->sclBit | p->sdaBit);
+    delay_us(5);
+
+    // Clock until the slave lets go of SDA
+    for(i = 0; i < 9 && !PORTReadBits(p->port, p->sdaBit); i++)
+    {
+        pinLow(p, p->sclBit);
+        delay_us(5);
+        pinRelease(p, p->sclBit);
+        delay_us(5);
+    }
+
+    // Stop: SDA rises while SCL is high
+    pinLow(p, p->sclBit);
+    delay_us(5);
+    pinLow(p, p->sdaBit);
+    delay_us(5);
+    pinRelease(p, p->sclBit);
+    delay_us(5);
+    pinRelease(p, p->sdaBit);
+    delay_us(5);
+
+    stuck = PORTReadBits(p->port, p->sclBit | p->sdaBit) != (p->sclBit | p->sdaBit);
+
+    // Hand the pins back (still inputs), and restart the module (BRG
+    // etc. are kept)
+    I2CClearStatus(p->module, I2C_ARBITRATION_LOSS);
+    I2CEnable(p->module, TRUE);
+    INTClearFlag(p->intM);
+    INTClearFlag(p->intB);
+
+    return stuck;
+}
+
+
+// busInterrupt - Common I2C master interrupt handling
+//
+static void busInterrupt(int bus)
+{
+    const busPort *p = &ports[bus];
+
+    if(INTGetFlag(p->intB))
+    {
+        // Bus collision: the hardware has already abandoned the
+        // transfer, so there's no stop to wait for.
+        INTClearFlag(p->intB);
+        INTClearFlag(p->intM);
+        I2CClearStatus(p->module, I2C_ARBITRATION_LOSS);
+        i2cBusEvent(bus, BUS_EV_COLLISION);
+        return;
+    }
+
+    INTClearFlag(p->intM);
+    i2cBusEvent(bus, BUS_EV_DONE);
+}
+
+
+// I2C master interrupts, one per module in ports[]
+//
+void __ISR(_I2C_1_VECTOR, ipl3) bus0Interrupt(void)
+{
+    CPU_IRQ_VAR(t0)
+
+    CPU_IRQ_ENTER(t0);
+    busInterrupt(0);
+    CPU_IRQ_LEAVE(CPU_BUS, t0);
+}
+
+#if defined GILBARCO_DUINOMITE
+void __ISR(BUS1_VECTOR, ipl3) bus1Interrupt(void)
+{
+    CPU_IRQ_VAR(t0)
+
+    CPU_IRQ_ENTER(t0);
+    busInterrupt(1);
+    CPU_IRQ_LEAVE(CPU_BUS, t0);
+}
+#endif
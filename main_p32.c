@@ -27,6 +27,13 @@
 #include "product_config.h"
 #include "p32_utils.h"       // Our misc utils for pic32 (delays, etc)
 #include "nxp_lcd_driver.h"  // 
+#include "sched.h"           // Tick scheduler
+#include "demo.h"            // Fill-up demo task
+#include "flow.h"            // Flow meter
+#include "cpu_load.h"        // Idle loop, CPU load
+#include "pos_link.h"        // Site controller link
+#include "i2c_trace.h"       // I2C transaction trace
+#include "uart.h"            // ...sent out of the UART
 
 
 #include "ConfigurationBits.h"
@@ -48,15 +55,29 @@ uint8_t segmentBuf[16];
 
 const char* testStr = "0123456789abcdefghijlnopstu0123456789";
 
+// The display set: the demo board on the UEXT i2c (bus 0). A second set
+// would get its own nxpDisplay & nxpConfig on bus 1 (I2C2 on 100 pin
+// parts, I2C3 on this 64 pin one; see lcd_bus_p32.c).
+static nxpDisplay lcdSet;
+static const nxpConfig lcdConfig = { 0, LCD_A1, LCD_A2, NXP_ALL_LCDS };
+
+
+#if defined I2C_TRACE && !defined POS_LINK
+// Send the I2C trace out of the UART, as far as its queue takes it, every
+// ms (for host/trace_dec)
+static void traceTask(void *ctx)
+{
+    (void)ctx;
+    i2cTraceDump(uartWrite);
+}
+#endif
+
 
 // main() ---------------------------------------------------------------------
 //
 int main(void)
 {
-    int i;
     int pbClk;         // Peripheral bus clock
-    char tempStr[16];
-    uint8_t tempBytes[16];
 
     // Pins that share ANx functions (analog inputs) will default to
     // analog mode (AD1PCFG = 0x0000) on reset.  To enable digital I/O
@@ -106,102 +127,30 @@ int main(void)
     INTEnableSystemMultiVectoredInt();
     
 
-    // Gilbarco, initialize
-    nxpInit(pbClk);
-
-    // TEST ONLY...  TODO: Some kind of init demo - all numbers, decimals, commas
-    lcdWrite(LCD_L1,"111111,");
-    lcdWrite(LCD_L1,"11111,1");
-    lcdWrite(LCD_L1,"1111,11");
-    lcdWrite(LCD_L1,"111,111");
-    lcdWrite(LCD_L1,"11,1111");
-
-    lcdWrite(LCD_S1,"7777,");
-    lcdWrite(LCD_S1,"777,7");
-    lcdWrite(LCD_S1,"77,77");
-    lcdWrite(LCD_S1,"7,777");
-    lcdWrite(LCD_S1,",7777");
-
-    lcdWrite(LCD_S1,"3.652");
-    lcdWrite(LCD_S2,"3.821");
-    lcdWrite(LCD_S3,"4.027");
-
-
-    // -----------------------------------------------------------
-    // Simple "fill-up" demo
-    //
-    // Continuously "pump" fuel (increment
-    // gallons & price), and display. When gallon count goes over
-    // a certain limit, reset, select a new fuel grade, and
-    // start all over.
-    //
-    char *fuelName[] =    // Three grades / types of fuel
-    {
-        "  87  ",
-        " 100LL",
-        " JET A"
-    };
-    double pricePerGallon[] =
-    {
-        3.652,  // mogas 87
-        3.821,  // 100LL
-        4.027   // JET-A
-    };
-
-    double totalPrice;
-    double totalGallons = 200.0;
-    int   fuelGrade = 2;
+    // Gilbarco, initialize. nxpInit() and the demo are scheduler tasks;
+    // from here on, everything runs from the loop below.
+    schedInit(pbClk);
+#ifdef FLOW_PULSER
+    flowInit(pbClk, FLOW_K_FACTOR);
+#endif
+    nxpInit(&lcdSet, &lcdConfig, pbClk);
+    demoStart(&lcdSet);
+#ifdef POS_LINK
+    posInit(&lcdSet, pbClk, POS_BAUD);
+#elif defined I2C_TRACE
+    uartInit(pbClk, I2C_TRACE_BAUD);
+    schedTimerStart(traceTask, 0, 1, 1);
+#endif
+#ifdef CPU_LOAD_STATS
+    cpuLoadStart();
+#endif
+
+    // Nothing due: WAIT for the next interrupt (the tick at the latest)
     while(1)
     {
-        // Pumping fuel: Increment gallons and price, and update big display
-        totalGallons += .009;  // .009 will make LS digit go thru all digits (backwards).
-        totalPrice = totalGallons * pricePerGallon[fuelGrade];
-        sprintf(tempStr, "%6.2f", totalPrice);
-        lcdWrite(LCD_L1, tempStr);
-        sprintf(tempStr, "%6.3f", totalGallons);
-        lcdWrite(LCD_L2, tempStr);
-
-        // When we hit 200g, cycle to the next fuel grade.
-        if(totalGallons > 200.0)
-        {
-            // Restart gallons at a high (non-zero) value, so we see lots of
-            // digits, and it won't take long to reset to a new fuel grade.
-            totalGallons = 180.0;               // Reset gallons
-            if(++fuelGrade >= 3) fuelGrade = 0; // Cycle fuel grade
-
-            // Displays all on
-            lcdWrite(LCD_L1,"888.,8.,8.,8");  // All LCD segments
-            lcdWrite(LCD_L2,"888.,8.,8.,8");  // All LCD segments
-            for(i=0;i<3;i++) lcdWrite(LCD_S1 + i, "8.,8.,8.,8");
-            delay_ms(1200);
-
-            // Show fuel type/name, and all three prices
-            lcdWrite(LCD_L1, fuelName[fuelGrade]);
-            lcdWrite(LCD_L2, "------");
-            for(i=0; i<3; i++)
-            {
-                sprintf(tempStr, "%5.3f", pricePerGallon[i]);
-                lcdWrite(LCD_S1 + i, tempStr);
-            }
-            delay_ms(1200);
-
-            // Flash the price for this fuel grade
-            sprintf(tempStr, "%5.3f", pricePerGallon[fuelGrade]);
-            for(i=0; i<4; i++)
-            {
-                lcdWrite(LCD_S1 + fuelGrade, "    ");
-                delay_ms(350);
-                lcdWrite(LCD_S1 + fuelGrade, tempStr);
-                delay_ms(350);
-            }
-
-            for(i=0;i<3;i++) lcdWrite(LCD_S1 + i, "----");  // Clear small LCDs
-            //sprintf(tempStr, "%5.3f", pricePerGallon[fuelGrade]);
-            lcdWrite(LCD_S1 + fuelGrade, tempStr);
-
-            //delay_ms(1500);
-        }
-        delay_us(500);
+        if(!schedRunOnce())
+            cpuIdle();
+        i2cService(lcdConfig.bus);
     }
 
 /* **********
@@ -230,28 +179,9 @@ int main(void)
 ***********  */
 
 /*
-    i = 0;
-    while(1)
-    {
-        // Copy 6 chars from the test string to a temp string
-        strncpy(tempStr, &testStr[i], 6);
-        tempStr[6] = 0;
-
-        // Display the 6 char substring from the test string
-        //h4235_SetSegments(tempStr, segmentBuf);
-        //h4235_Write(1, segmentBuf);
-        //h4235_SetSegments(tempStr, segmentBuf);
-        //h4235_Write(2, segmentBuf);
-
-        lcdWrite(LCD_L1, tempStr);
-        lcdWrite(LCD_L2, tempStr);
-        //lcdWrite(LCD_S1, tempStr);
-        delay_ms(350);
-
-        // Move to the next location in the test string
-        i++;
-        if(i > 9) i = 0;
-    }
+    // Scroll the test string across the top line, a character every
+    // 350ms (from the scheduler; the main loop above keeps running)
+    lcdScroll(&lcdSet, LCD_L1, testStr, 350);
 */   
     return 0;
 }
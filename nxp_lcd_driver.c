@@ -64,21 +64,110 @@
 //    [0x70 0xe0 0x00 0x0c 0xb6 0x9e 0xcc 0x07]   ; "4321" & commas
 //
 
-#include <p32xxxx.h>
-#include <plib.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "product_config.h"
 #include "nxp_lcd_driver.h"
+#include "i2c_master.h"
+#include "glyphs.h"
+#include "glass.h"
+#include "perf_stats.h"
+#include "cpu_load.h"
+#include "sched.h"
 #include "p32_utils.h"
+#ifdef LCD_LAMP_TEST
+  #include "anim_table.h"
+#endif
 
 
-// Define which I2C port the driver is attached to
-#if defined GILBARCO_DUINOMITE
-  #define LCD_I2C_BUS I2C1
-#else
-  #error need a product defined
-#endif
+// Segment data bytes actually wired on each glass (see mappings above)
+#define H4235_NBYTES  7
+#define H4198_NBYTES  5
+
+// Driver state lives in the caller's nxpDisplay (nxp_lcd_driver.h), one
+// per display set, so several sets can run at once on their own buses.
+// The notes below are on its fields.
+//
+// Shadows (shadow[]): each controller's segment RAM, as last queued, for
+// both RAM banks (see "Double buffering" below). lcdWrite() compares
+// against this and only sends the bytes that changed. A shadow is only
+// trusted once a full image has been queued, and is dropped whenever the
+// i2c engine reports a failed transaction on the bus (we don't track
+// which one, so all of them go).
+//
+// Pending updates (pending, pendSeg[]): with coalescing on (refreshMs;
+// see lcdRefreshRate()), the latest image written to each LCD, waiting
+// for the next flush. The flush sends them as a frame, so it still only
+// queues the bytes that differ from the shadows.
+
+// Blinking (lcdBlink()). The blink command is taken by every controller
+// at an address, so blink state is per address group: the H4235 lines
+// (saLarge) and the H4198s (saSmall). Bank selection (double buffering)
+// is the same; the per group arrays are [0] large, [1] small.
+#define GROUP_LARGE  ((1 << LCD_L1) | (1 << LCD_L2))
+#define GROUP_SMALL  ((1 << LCD_S1) | (1 << LCD_S2) | (1 << LCD_S3))
+
+static int lcdGroup(int lcd);
+static int lcdGroupNum(int lcd);
+static int lcdNeedsMirror(nxpDisplay *d, int lcd);
+static int nxpWriteBack(nxpDisplay *d, int lcd, const uint8_t seg[], int first, int last);
+static int nxpBankCmd(uint8_t bytes[], int n, int lcd, int in, int out, int last);
+
+// Power-up sequence (nxpInit()), run as a scheduler task
+#define NXP_INIT_BUS      0   // Bring up the i2c interface (and LCD power)
+#define NXP_INIT_CMDS     1   // Init commands to each controller type
+#define NXP_INIT_ACK      2   // Poll until they've all been ACK'd
+#define NXP_INIT_PROBE    3   // Test writes at the next bus speed to try
+#define NXP_INIT_CHECK    4   // See how they went
+#define NXP_INIT_DONE     5
+
+#define NXP_READY_MS     20   // Give up on an unanswered controller after this
+
+static void nxpInitTask(void *ctx);
+
+// Minimal init, per controller type: static drive, display enabled, RAM
+// bank 0 in and out, blinking off. Bar the mode set, those are the
+// power-on defaults, but a re-init may follow anything.
+static const uint8_t nxpInitSmall[] =   // PCF85176: C (bit 7) set on all but the last
+{
+    0xc9,   // Mode set: enabled, static
+    0xf8,   // Bank select: in & out bank 0
+    0x70    // Blink select: off; last command
+};
+static const uint8_t nxpInitLarge[] =   // PCF85134: a control byte, then commands
+{
+    0x00,   // Control byte: Co = 0 (no more control bytes), RS = 0 (commands)
+    0xc9,   // Mode set: enabled, static
+    0xf8,   // Bank select: in & out bank 0
+    0xf0    // Blink select: off
+};
+
+// Bus speeds, fastest first. 400KHz (Fast-mode) is the most either the
+// PCF85176 or the PCF85134 supports; 100KHz is the floor. nxpInit()
+// settles on the first one that takes a test write to every display,
+// and nxpSpeedTask() steps down a notch if NACKs start turning up.
+static const uint32_t nxpSpeeds[] = { 400000, 200000, 100000 };
+#define NXP_SPEEDS  (sizeof(nxpSpeeds) / sizeof(nxpSpeeds[0]))
+
+#define NXP_SPEED_CHECK_MS  1000  // NACK rate sampling period
+#define NXP_NACK_MIN        3     // Step down on at least this many NACKs...
+#define NXP_NACK_RATIO      50    // ...when more than 1 in this many transactions
+
+static void nxpSpeedTask(void *ctx);
+
+static int nxpWriteSpan(nxpDisplay *d, int lcd, int bank, const uint8_t seg[], int first, int last,
+                        i2cCallback done, void *ctx, i2cHandle *handle);
+static int frameCommitFlip(nxpDisplay *d, int g, i2cCallback done, void *ctx, i2cHandle *handle);
+static int lcdFlipping(nxpDisplay *d, int g);
+static void lcdShadowSet(nxpDisplay *d, int lcd, const uint8_t seg[], int nBytes, i2cHandle h);
+static int frameCommit(nxpDisplay *d, i2cHandle *handle);
+static int lcdFlushArm(nxpDisplay *d);
+static void lcdLampTask(void *ctx);
+static void nxpInitGroup(nxpDisplay *d, int g);
+static void lcdScrollStop(nxpDisplay *d, int lcd);
+static void lcdAnimTask(void *ctx);
+static int animStart(nxpDisplay *d, const lcdAnim *anim, schedFunc done, void *ctx);
 
 
 // PIC32 I2C notes
@@ -98,6 +187,11 @@
 // 
 // PIC32 Family Reference Manual, Ch. 24 ("Inter-Integrated Circuit")
 // has a good i2c overview.
+//
+// The bus itself is run by the interrupt driven engine in i2c_master.c;
+// this file only builds the byte sequences and queues them. Nothing here
+// touches the PIC32 directly (that's lcd_bus_p32.c), so the driver also
+// builds on a Linux host against the controller emulator in host/.
 
 
 // nxpInit - Initialize the driver for static operation
@@ -111,77 +205,299 @@
 //   - Data ptr & sub-addr counter set to 0
 //   - Display is disabled
 //
-// This routine sets the LCD drivers to static mode, blinking off, enabled
+// This routine sets the LCD drivers to static mode, blinking off, enabled,
+// and picks the bus speed (see nxpSpeeds[]). With LCD_LAMP_TEST
+// (product_config.h), a lamp test (lcdLampTest(), animLampTest) then
+// starts, but the displays are ready before it ends.
+//
+// There are no fixed waits: each controller type gets its own minimal
+// command sequence straight away, and one still in its power-on reset
+// (NACKing its address) is polled until it answers. So the sequence
+// takes a few milliseconds. It runs as a scheduler task (nxpInitTask());
+// this just starts it. nxpReady() says when it's done.
 //
-void nxpInit(int pbClk)
+// d holds the display set's state; cfg says which bus it's on, its
+// controller addresses and which LCDs are fitted. Each nxpDisplay must
+// start out zeroed (static storage is); it may be re-initialized.
+//
+void nxpInit(nxpDisplay *d, const nxpConfig *cfg, int pbClk)
 {
-    uint8_t initBytes[32];
-    uint32_t actualFreq;
     int i;
 
-    delay_ms(2);    // Delay at least 1ms after POR before i2c comms
-
-    // Set up the i2c interface
-    //
-#if defined GILBARCO_DUINOMITE
-    // 3.3v on UEXT is switched by RB13
-    TRISBCLR = BIT_13;  // Set RB12 as output
-    LATBCLR = BIT_13;   // Low to enable 3.3v
+    if(d->initPbClk)                          // Re-init: drop the old timers
+    {
+        schedTimerStop(d->speedTimer);
+        schedTimerStop(d->flushTimer);
+        schedTimerStop(d->animTimer);
+        for(i=0; i<=LCD_S3; i++)
+            schedTimerStop(d->scroll[i].timer);
+    }
+    d->speedTimer = SCHED_NO_TIMER;
+    d->flushTimer = SCHED_NO_TIMER;
+    d->lampOn = 0;
+    d->animTimer = SCHED_NO_TIMER;
+    d->anim = 0;
+
+    d->bus = cfg->bus;
+    d->saSmall = cfg->saSmall;
+    d->saLarge = cfg->saLarge;
+    d->lcds = cfg->lcds;
+    d->initPbClk = pbClk;
+    d->initState = NXP_INIT_BUS;
+    d->speedIdx = 0;
+    d->blinkMask = 0;
+    d->blinkRate[0] = d->blinkRate[1] = LCD_BLINK_OFF;
+    d->frontBank[0] = d->frontBank[1] = 0;         // The init commands select bank 0
+    d->bankLost = 0;
+    d->initLost = 0;
+#ifdef LCD_DOUBLE_BUFFER
+    d->dblBuf = 1;
+#else
+    d->dblBuf = 0;
+#endif
+    d->frameOpen = 0;
+    d->pending = 0;
+#ifdef LCD_REFRESH_HZ
+    d->refreshMs = 1000 / LCD_REFRESH_HZ;
 #else
-  #error define a product...
+    d->refreshMs = 0;
+#endif
+    for(i=0; i<=LCD_S3; i++)
+    {
+        d->shadow[i].valid = 0;
+        d->counter[i].on = 0;
+        d->scroll[i].timer = SCHED_NO_TIMER;
+    }
+    schedTimerStart(nxpInitTask, d, 0, 0);
+}
+
+
+// nxpReady - Non-zero once nxpInit()'s sequence has finished (never, if
+//            the configured bus doesn't exist on this part)
+//
+int nxpReady(nxpDisplay *d)
+{
+    return d->initState == NXP_INIT_DONE;
+}
+
+
+// nxpBusSpeed - The i2c SCL rate in use, as negotiated by nxpInit()
+//               (and stepped down since, if need be)
+//
+uint32_t nxpBusSpeed(nxpDisplay *d)
+{
+    return i2cSpeed(d->bus);
+}
+
+
+// nxpSpeedTask
+//
+// Periodic check of the NACK rate. A rising rate at a given speed (a
+// marginal bus: long wiring, a warm cabinet) means it's time to slow
+// down; failed writes are re-sent in full anyway, as they drop the
+// shadows.
+//
+// It also looks after a group that never answered at power-up (initLost):
+// its init goes again each time (once the last try has finished), until
+// it's ACK'd. Its RAM is junk then, so each of its LCDs is sent, in
+// full, the latest image it was given.
+//
+static void nxpSpeedTask(void *ctx)
+{
+    nxpDisplay *d = ctx;
+    uint32_t xfers = i2cXferCount(d->bus) - d->lastXfers;
+    uint32_t nacks = i2cNackCount(d->bus) - d->lastNacks;
+    int lost = d->initLost;
+    int g, lcd;
+
+    for(g = 0; g < 2; g++)
+    {
+        if(!(d->initLost & (1 << g)) || d->initStatus[g] == I2C_PENDING)
+            continue;
+        if(d->initStatus[g] != I2C_OK)
+        {
+            nxpInitGroup(d, g);
+            continue;
+        }
+        d->initLost &= ~(1 << g);
+        d->bankLost |= 1 << g;              // The init selected bank 0
+        for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+        {
+            if(lcdGroupNum(lcd) != g || !(d->lcds & (1 << lcd)) || (d->pending & (1 << lcd)))
+                continue;
+            d->shadow[lcd].valid = 0;
+            memcpy(d->pendSeg[lcd], d->shadow[lcd].seg[d->frontBank[g]], sizeof(d->pendSeg[lcd]));
+            d->pending |= 1 << lcd;
+        }
+        lcdFlushArm(d);
+    }
+
+    d->lastXfers += xfers;
+    d->lastNacks += nacks;
+
+    // Not while a group was missing: its NACKs say nothing about the speed
+    if(!lost && nacks >= NXP_NACK_MIN && nacks * NXP_NACK_RATIO > xfers &&
+       d->speedIdx < NXP_SPEEDS - 1)
+    {
+        i2cSetSpeed(d->bus, nxpSpeeds[++d->speedIdx]);
+    }
+}
+
+
+// nxpWriteAll - Queue the same byte to every segment byte of each
+//               fitted LCD, bar those in a group that hasn't answered
+//               (initLost): their NACKs say nothing about the speed
+//
+static void nxpWriteAll(nxpDisplay *d, uint8_t fill)
+{
+    uint8_t segData[8];
+    int lcd;
+
+    memset(segData, fill, sizeof(segData));
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if(!(d->lcds & (1 << lcd)) || (d->initLost & (1 << lcdGroupNum(lcd))))
+            continue;
+        if(lcd <= LCD_L2)
+            h4235_Write(d, lcd - LCD_L1 + 1, segData, 0, 0, 0);
+        else
+            h4198_Write(d, lcd - LCD_S1 + 1, segData, 0, 0, 0);
+    }
+}
+
+
+// nxpInitDone - Completion callback for the init commands: the status
+//               goes straight into initStatus[g] (ctx). A handle would
+//               do for the ACK polling, but not for nxpSpeedTask(): its
+//               queue slot has long been reused by the time that looks.
+//
+static void nxpInitDone(i2cHandle h, int status, void *ctx)
+{
+    (void)h;
+    *(volatile int8_t *)ctx = status;
+}
+
+
+// nxpInitGroup - Queue the init commands for group g (0 large, 1 small);
+//                initStatus[g] is I2C_PENDING until they're done. If the
+//                queue is full, the old status stays, so they're tried
+//                again on the next poll.
+//
+static void nxpInitGroup(nxpDisplay *d, int g)
+{
+    int8_t old = d->initStatus[g];
+
+    d->initStatus[g] = I2C_PENDING;          // Before the callback can run
+    if(g == 0 ? i2cSubmit(d->bus, d->saLarge, nxpInitLarge, sizeof(nxpInitLarge),
+                          nxpInitDone, (void *)&d->initStatus[g], 0)
+              : i2cSubmit(d->bus, d->saSmall, nxpInitSmall, sizeof(nxpInitSmall),
+                          nxpInitDone, (void *)&d->initStatus[g], 0))
+        d->initStatus[g] = old;
+}
+
+
+// nxpInitTask - One step of the power-up sequence per call; each step
+//               arms the timer for the next.
+//
+static void nxpInitTask(void *ctx)
+{
+    nxpDisplay *d = ctx;
+    uint32_t wait = 0;
+    int g, status, again = 0;
+
+    switch(d->initState)
+    {
+        case NXP_INIT_BUS:
+            // Set up the i2c interface (and power; see busInit()), at
+            // the safe speed for the init commands
+            if(!i2cInit(d->bus, d->initPbClk, nxpSpeeds[NXP_SPEEDS - 1]))
+                return;     // No such bus here; never ready
+            break;
+
+        case NXP_INIT_CMDS:
+            // Each fitted group's init commands (see nxpInitSmall[] &
+            // nxpInitLarge[]). The time limit on the ACK polling runs
+            // from here.
+            d->initStart = schedTicks();
+            for(g = 0; g < 2; g++)
+            {
+                d->initStatus[g] = (d->lcds & (g ? GROUP_SMALL : GROUP_LARGE)) ?
+                                   I2C_ERR_QUEUE_FULL : I2C_OK;
+                if(d->lcds & (g ? GROUP_SMALL : GROUP_LARGE))
+                    nxpInitGroup(d, g);
+            }
+            wait = 1;
+            break;
+
+        case NXP_INIT_ACK:
+            // A controller still in its power-on reset doesn't ACK its
+            // address, so the init goes again, a tick later, until it
+            // does. Past NXP_READY_MS we carry on without it (writes to it
+            // will fail, and be sent in full once it answers).
+            for(g = 0; g < 2; g++)
+            {
+                status = d->initStatus[g];
+                if(status == I2C_PENDING)
+                    again = 1;
+                else if(status != I2C_OK && schedTicks() - d->initStart < NXP_READY_MS)
+                {
+                    nxpInitGroup(d, g);
+                    again = 1;
+                }
+                else if(status != I2C_OK)
+                    d->initLost |= 1 << g;      // nxpSpeedTask() keeps trying
+            }
+            if(again)
+            {
+                schedTimerStart(nxpInitTask, ctx, 1, 0);
+                return;
+            }
+            break;
+
+        case NXP_INIT_PROBE:
+            // Try the next speed: a blank test write to each display
+            // that has answered (the address ACKs are the probe; the
+            // lamp test overwrites the data). One that hasn't is blanked
+            // when it does (nxpSpeedTask()).
+            i2cSetSpeed(d->bus, nxpSpeeds[d->speedIdx]);
+            d->probeErrors = i2cErrorCount(d->bus);
+            nxpWriteAll(d, 0);
+            wait = 1;
+            break;
+
+        case NXP_INIT_CHECK:
+            // Once the test writes are done: keep this speed if they all
+            // went through, else try the next one down. If even the
+            // slowest fails, we carry on at that.
+            if(i2cPending(d->bus))
+            {
+                schedTimerStart(nxpInitTask, ctx, 1, 0);
+                return;
+            }
+            if(i2cErrorCount(d->bus) != d->probeErrors && d->speedIdx < NXP_SPEEDS - 1)
+            {
+                d->speedIdx++;
+                d->initState = NXP_INIT_PROBE;
+                schedTimerStart(nxpInitTask, ctx, 0, 0);
+                return;
+            }
+            d->lastXfers = i2cXferCount(d->bus);
+            d->lastNacks = i2cNackCount(d->bus);
+            d->speedTimer = schedTimerStart(nxpSpeedTask, d, NXP_SPEED_CHECK_MS, NXP_SPEED_CHECK_MS);
+
+            // Ready: the test writes left the glass blank
+            d->initState = NXP_INIT_DONE;
+#ifdef LCD_LAMP_TEST
+            lcdLampTest(d, &animLampTest);
 #endif
+            return;
+
+        default:
+            return;
+    }
 
-    I2CConfigure(LCD_I2C_BUS, 0 /*I2C_ENABLE_SLAVE_CLOCK_STRETCHING | I2C_ENABLE_HIGH_SPEED*/);
-    actualFreq = I2CSetFrequency(LCD_I2C_BUS, pbClk, 100000);  // Seemed OK at 400KHz
-    //actualFreq = I2CSetFrequency(LCD_I2C_BUS, pbClk, 40000);  // Seemed OK at 400KHz
-    //I2CSetSlaveAddress(...   not needed if we're master only)
-    I2CEnable(LCD_I2C_BUS, TRUE);
-    delay_ms(10);   // Note that some delay IS REQUIRED before i2c comms start.
-
-
-    // Set up data bytes to be sent for init, including:
-    //
-    //   Mode-set command (0xC0) or'd with:
-    //      bit3    =  1 (enable display), and
-    //      bits1,0 = 01 (static mode)
-    //
-
-    // TODO: This init byte-sequence is a holdover from when we were trying
-    //       to accomodate both IC types. It should be seperated out and
-    //       optimized/cleaned-up for each of the PCF85134 & PCF85176 ICs
-    //
-    //                        60seg                    40seg
-    //                        ----------------         -----------------
-    initBytes[0] = 0x80;   // Command follows          DataPtr=0
-    initBytes[1] = 0xc9;   // Mode set                 same
-    initBytes[2] = 0x80;   // Command follows          DataPtr=0
-    initBytes[3] = 0xF8;   // In & out bank select 0   same
-    initBytes[4] = 0x00;   // (last) command follows   ?
-    // TODO: This is interpreted as data by the 4198's; Not a big deal, but...
-    initBytes[5] = 0xf0;   // Blink mode normal, off   same? ignored?
-
-    nxpRawWrite(LCD_A1, initBytes, 6);  // Small displays
-    delay_ms(2);
-    nxpRawWrite(LCD_A2, initBytes, 6);  // Large display
-    delay_ms(2);
-
-    // Set all segments on
-    for(i=0; i<16; i++) initBytes[i] = 0xff;
-    h4235_Write(1,initBytes);
-    h4235_Write(2,initBytes);
-    h4198_Write(1,initBytes);
-    h4198_Write(2,initBytes);
-    h4198_Write(3,initBytes);
-    delay_ms(750);
-
-    // Turn all segments off
-    for(i=0; i<16; i++) initBytes[i] = 0;
-    h4235_Write(1,initBytes);
-    h4235_Write(2,initBytes);
-    h4198_Write(1,initBytes);
-    h4198_Write(2,initBytes);
-    h4198_Write(3,initBytes);
-    delay_ms(200);
+    d->initState++;
+    schedTimerStart(nxpInitTask, ctx, wait, 0);
 }
 
 
@@ -191,13 +507,19 @@ void nxpInit(int pbClk)
 // The H4235 consists of two, 6-digit displays, each of which is
 // controlled by its own NXP PCF85134 60-segment LCD controller.
 //
-// Returns zero on success
+// The write is queued to the I2C engine; done/ctx/handle are passed
+// through to i2cSubmit() (any may be 0).
 //
-int h4235_Write(int disp,         // Display number: 1 (top) or 2 (bottom)
-               uint8_t segData[]) // 60bits (7.5bytes) of LCD segment data
+// Returns zero once queued
+//
+int h4235_Write(nxpDisplay *d,
+                int disp,           // Display number: 1 (top) or 2 (bottom)
+                uint8_t segData[8], // 60bits (7.5bytes) of LCD segment data
+               i2cCallback done, void *ctx, i2cHandle *handle)
 {
     int i;
     uint8_t bytesToSend[16];
+    i2cHandle h;
 
     if(disp < 1 || disp > 2) 
         return 1;                 // Error
@@ -215,10 +537,17 @@ int h4235_Write(int disp,         // Display number: 1 (top) or 2 (bottom)
     {
         bytesToSend[i+5] = segData[i];
     }
-    bytesToSend[12] = 0;          // 8th data byte (10th byte overall) is not used
+    // The 8th data byte is not used, and isn't sent: only 4 of its bits
+    // fit in the 60 segment RAM, and the rest would spill over (via the
+    // subaddress counter) into the other line's controller.
+
+    // Queue the write to the controller IC
+    i = i2cSubmit(d->bus, d->saLarge, bytesToSend, 12, done, ctx, &h);
+    if(i) return i;
 
-    // Write to the controller IC
-    return nxpRawWrite(LCD_A2, bytesToSend, 13);
+    lcdShadowSet(d, disp == 1 ? LCD_L1 : LCD_L2, segData, H4235_NBYTES, h);
+    if(handle) *handle = h;
+    return 0;
 }
 
 
@@ -231,6 +560,7 @@ int h4235_Write(int disp,         // Display number: 1 (top) or 2 (bottom)
 // Inputs:
 //   dispNum - Which of the 3 displays to write to, 1..3 (3 on right)
 //   segData - Raw segment data, 5 bytes (40 segments)
+//   done, ctx, handle - Passed through to i2cSubmit() (any may be 0)
 //
 // Note: The dispNum 1..3 maps to the controller IC's "device addresses", 0..2.
 //       These can be set via jumpers on the H4198 demo board:
@@ -238,12 +568,14 @@ int h4235_Write(int disp,         // Display number: 1 (top) or 2 (bottom)
 //         Middle (dispNum 2): Jumper "A0" (device addr 1)
 //         Right  (dispNum 3): Jumper "A1" (device addr 2)
 //
-// Returns zero on success; Error code otherwise.
+// Returns zero once queued; Error code otherwise.
 //
-int h4198_Write(int dispNum, uint8_t segData[])
+int h4198_Write(nxpDisplay *d, int dispNum, uint8_t segData[5],
+                i2cCallback done, void *ctx, i2cHandle *handle)
 {
     int i;
     uint8_t bytesToSend[16];
+    i2cHandle h;
 
     // Check dispNum in range
     if(dispNum < 1 || dispNum > 3)
@@ -259,366 +591,1467 @@ int h4198_Write(int dispNum, uint8_t segData[])
         bytesToSend[i+2] = segData[i];
     }
 
-    // Send to the controller IC
-    return nxpRawWrite(LCD_A1, bytesToSend, 7);
+    // Queue for the controller IC
+    i = i2cSubmit(d->bus, d->saSmall, bytesToSend, 7, done, ctx, &h);
+    if(i) return i;
+
+    lcdShadowSet(d, LCD_S1 + dispNum - 1, segData, H4198_NBYTES, h);
+    if(handle) *handle = h;
+    return 0;
 }
 
 
-// nxpRawWrite
+// nxpWriteSpan - Queue a partial write of segment bytes first..last to
+//                one LCD, using the data pointer to start part way in.
 //
-// Write n data bytes to the LCD driver IC, via i2c bus. This includes
-// preceding the bytes with an i2c start condition, and following the
-// bytes with an i2c stop condition.
+// In static drive mode each data byte fills 8 RAM addresses, so the
+// data pointer for segment byte k is k*8 on both controller types.
 //
-// Inputs:
-//   sa   - I2C Slave address (we use 2: 0x70 and 0x72)
-//   data - Byte array data to send
-//   n    - Length of byte array
+// The write goes to RAM bank 'bank'. Normally that's the one on the
+// glass, and already the input bank; for the other one (or if the bank
+// selection is in doubt; see lcdShadowCheck()) a bank select goes first.
 //
-// Returns 0 on success; Error code otherwise TODO: Meaningfull error codes
+static int nxpWriteSpan(nxpDisplay *d, int lcd, int bank, const uint8_t seg[], int first, int last,
+                        i2cCallback done, void *ctx, i2cHandle *handle)
+{
+    uint8_t bytesToSend[20];
+    uint8_t sa;
+    int g = lcdGroupNum(lcd);
+    int n = 0;
+    int retval;
+
+    if(bank != d->frontBank[g] || (d->bankLost & (1 << g)))
+        n = nxpBankCmd(bytesToSend, n, lcd, bank, d->frontBank[g], 0);
+
+    if(lcd == LCD_L1 || lcd == LCD_L2)   // PCF85134: control byte before each command
+    {
+        bytesToSend[n++] = 0x80;                        // Control byte: Command follows
+        bytesToSend[n++] = (lcd == LCD_L1) ? 0xe1 : 0xe0;  // Device address for the line
+        bytesToSend[n++] = 0x80;                        // Control byte: Command follows
+        bytesToSend[n++] = first * 8;                   // Data pointer
+        bytesToSend[n++] = 0x40;                        // Control byte: Data follows
+        sa = d->saLarge;
+    }
+    else                                 // PCF85176: continuation bit in each command
+    {
+        bytesToSend[n++] = 0x80 | (first * 8);          // Data pointer; More commands follow
+        bytesToSend[n++] = 0x60 | (lcd - LCD_S1);       // Device address; data follows
+        sa = d->saSmall;
+    }
+
+    while(first <= last)
+        bytesToSend[n++] = seg[first++];
+
+    retval = i2cSubmit(d->bus, sa, bytesToSend, n, done, ctx, handle);
+    if(!retval)
+        d->bankLost &= ~(1 << g);
+    return retval;
+}
+
+
+// lcdShadowSet - Record a full segment image as queued for an LCD (to
+//                the input bank, which outside of a bank write is the
+//                one on the glass)
+//
+static void lcdShadowSet(nxpDisplay *d, int lcd, const uint8_t seg[], int nBytes, i2cHandle h)
+{
+    int g = lcdGroupNum(lcd);
+    int bank = d->frontBank[g];
+
+    memcpy(d->shadow[lcd].seg[bank], seg, nBytes);
+    d->shadow[lcd].valid = (d->bankLost & (1 << g)) ? 0 : (1 << bank);
+    d->shadow[lcd].last = h;
+}
+
+
+// lcdShadowCheck
 //
-// TODO: Add timeouts all over
+// Any failed transaction since we last looked? Then no shadow can be
+// trusted; everything gets resent. Nor can the bank selection (the one
+// that failed may have been a bank select), so the next write to each
+// group sets it again.
 //
-int nxpRawWrite(uint8_t sa, uint8_t data[], int n)
+static void lcdShadowCheck(nxpDisplay *d)
 {
-    int i;
-    I2C_STATUS status;
+    int lcd;
+    uint32_t errors = i2cErrorCount(d->bus);
 
-    // Wait for bus idle, then issue an i2c start
-    while(!I2CBusIsIdle(LCD_I2C_BUS))
+    if(errors != d->shadowErrors)
     {
-        // TODO: If the nxp's get stuck, this stop seems to shake
-        // them loose.  Verify this a valid thing to do?
-        // TODO: Proper timout, here and everywhere.
-        I2CStop(LCD_I2C_BUS);
-        delay_ms(2);
+        d->shadowErrors = errors;
+        for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+            d->shadow[lcd].valid = 0;
+        d->bankLost = 3;
     }
+}
+
 
-    // MAGIC ALERT! The addition of this statement seems to get this code working.
-    // Without this, the following do..while() loop hangs forever.
-    status = I2CGetStatus(LCD_I2C_BUS);
+// lcdDiffSpan
+//
+// Find the span of bytes in seg[] that differ from the LCD's shadow of
+// one RAM bank (the whole image if that shadow isn't valid).
+//
+// Returns 0 if nothing changed; otherwise 1, with the span in
+// *first..*last.
+//
+static int lcdDiffSpan(nxpDisplay *d, int lcd, int bank, const uint8_t seg[], int nBytes, int *first, int *last)
+{
+    const uint8_t *sh = d->shadow[lcd].seg[bank];
+    int f = 0;
+    int l = nBytes - 1;
 
-    // I2C Start (Returns either success or I2C_MASTER_BUS_COLLISION)
-    if(I2CStart(LCD_I2C_BUS) != I2C_SUCCESS)
+    if(d->shadow[lcd].valid & (1 << bank))
     {
-        return 1;
+        while(f < nBytes && seg[f] == sh[f])
+            f++;
+        if(f == nBytes)   // Unchanged
+            return 0;
+        while(seg[l] == sh[l])
+            l--;
     }
+    *first = f;
+    *last = l;
+    return 1;
+}
+
+
+// lcdWriteDiff
+//
+// Queue only the bytes of seg[] that differ from the LCD's shadow, as one
+// contiguous span (first changed byte .. last changed byte). If nothing
+// changed, nothing is sent; *handle is then the still-pending write that
+// will put this image on the glass, or I2C_HANDLE_NONE if it's already
+// there, and done (if any) is called straight away.
+//
+// While a frame is open (lcdBeginFrame), the image is only staged, to go
+// out with the rest of the frame in lcdCommitFrame(); done isn't called.
+// When coalescing, it's only left waiting for the next flush, unless the
+// caller wants to know when it's done. When double buffered, the write
+// is sent as a one-LCD frame (to the hidden bank, then a flip); done
+// then follows the flip.
+//
+static int lcdWriteDiff(nxpDisplay *d, int lcd, const uint8_t seg[], int nBytes,
+                        i2cCallback done, void *ctx, i2cHandle *handle)
+{
+    lcdShadow *sh = &d->shadow[lcd];
+    int g = lcdGroupNum(lcd);
+    int first, last;
+    int retval;
+    i2cHandle h;
 
-    // Wait for the start to complete. NOTE: Hangs forever, without
-    // the dummy I2CGetStatus(), prior to the I2CStart() call.
-    do 
+    if(d->frameOpen)
     {
-        status = I2CGetStatus(LCD_I2C_BUS);
-        if(I2C_ARBITRATION_LOSS & status)
-            I2CClearStatus(LCD_I2C_BUS, I2C_ARBITRATION_LOSS);
-    } while ( !(status & I2C_START) );
-    
-    // Send the device slave address (this device is write-only,
-    // so the R/W bit (bit 0) of the slave address is always zero.
-    //
-    while(!I2CTransmitterIsReady(LCD_I2C_BUS));
-    status = I2CSendByte(LCD_I2C_BUS, sa);
-    if(status != (I2C_STATUS)I2C_SUCCESS)
+        memcpy(d->frameSeg[lcd], seg, nBytes);
+        d->frameStaged |= 1 << lcd;
+        if(handle) *handle = I2C_HANDLE_NONE;
+        return 0;
+    }
+
+    if(d->refreshMs || d->lampOn)
     {
-        return 2;
+        if(!done && !handle)
+        {
+            memcpy(d->pendSeg[lcd], seg, nBytes);
+            d->pending |= 1 << lcd;
+            return lcdFlushArm(d);
+        }
+        d->pending &= ~(1 << lcd);    // This one goes now, and is newer
     }
-    while(!I2CTransmissionHasCompleted(LCD_I2C_BUS));
-    if(!I2CByteWasAcknowledged(LCD_I2C_BUS))
+
+    lcdShadowCheck(d);
+    if(!lcdDiffSpan(d, lcd, d->frontBank[g], seg, nBytes, &first, &last))
     {
-        return 3;
+        h = sh->last;
+        if(i2cPoll(d->bus, h) != I2C_PENDING)
+            h = I2C_HANDLE_NONE;
+        if(handle) *handle = h;
+        if(done) done(h, I2C_OK, ctx);
+        return 0;
     }
 
-    // Send the remaining data bytes.
-    //
-    for(i=0; i<n; i++)
+    if(lcdFlipping(d, g))
     {
-        while(!I2CTransmitterIsReady(LCD_I2C_BUS));
-        status = I2CSendByte(LCD_I2C_BUS, data[i]);
-        if(status != (I2C_STATUS)I2C_SUCCESS)
-        {
-            return 4;
-        }
-        while(!I2CTransmissionHasCompleted(LCD_I2C_BUS));
-        if(!I2CByteWasAcknowledged(LCD_I2C_BUS))
-        {
-            return 5;
-        }
+        memcpy(d->frameSeg[lcd], seg, nBytes);
+        d->frameStaged = 1 << lcd;
+        retval = frameCommitFlip(d, g, done, ctx, handle);
+        d->frameStaged = 0;
+        return retval;
     }
 
-    // I2C Stop
-    I2CStop(LCD_I2C_BUS);
-    do {
-        status = I2CGetStatus(LCD_I2C_BUS);
-    } while(!(status & I2C_STOP));
+    // The hidden bank copy (see lcdBlink()) has to go too, or the LCD
+    // would blink between old and new
+    if(lcdNeedsMirror(d, lcd) && I2C_QUEUE_DEPTH - i2cPending(d->bus) < 3)
+        return I2C_ERR_QUEUE_FULL;
 
-    return 0;   // Successful return value
-}
+    retval = nxpWriteSpan(d, lcd, d->frontBank[g], seg, first, last, done, ctx, &h);
+    if(retval) return retval;   // Not queued; shadow still shows the old data
+    if(lcdNeedsMirror(d, lcd))
+        nxpWriteBack(d, lcd, seg, first, last);
 
+    memcpy(&sh->seg[d->frontBank[g]][first], &seg[first], last - first + 1);
+    sh->valid |= 1 << d->frontBank[g];
+    sh->last = h;
+    if(handle) *handle = h;
+    return 0;
+}
 
 
-// h4235SetSegments / h4198SetSegments
+// lcdBeginFrame
 //
-// Given a string to display (displayStr), prepare the bytes
-// that will be sent to the LCD driver to show that string.
+// Start gathering a frame: until lcdCommitFrame(), lcdWrite() and
+// friends only stage their segment data. Handles returned for staged
+// writes are I2C_HANDLE_NONE; use the one from lcdCommitFrame().
 //
-// Since bytes ordering is different for the H4198 & H4235,
-// each has their variant of this routine.
+void lcdBeginFrame(nxpDisplay *d)
+{
+    d->frameOpen = 1;
+    d->frameStaged = 0;
+}
+
+
+// frameCommitLarge
 //
-// Inputs:
-//   displayStr - The string to display, with optional decimal
-//                points or commas.
-//                Example input strings:
-//                    "1.23"
-//                    "123"
-//                    " 5,95"
-// Outputs:
-//   segmentByte  - Array of bytes that, when sent to the LCD
-//                driver, will energize the correct segments to
-//                display the input string.
+// Queue the staged H4235 lines as one transaction to the two PCF85134s
+// (saLarge). The PCF85134 takes a control byte ahead of each command or
+// data byte; with its continuation bit (Co) set, another control byte
+// follows, so every line but the last has its data sent as 0xC0,<data>
+// pairs, and the last line ends with a plain 0x40 data run. The line
+// with the longer span goes last, to keep the pairs to a minimum.
 //
-// Returns 0 on success; Error code otherwise
+// The data goes to RAM bank 'bank': the one on the glass, or the hidden
+// one when double buffered.
 //
-int h4198_SetSegments(const char *displayStr,   // Display string to process
-                      uint8_t segmentByte[5])   // Return 5 data bytes (40segments)
+static int frameCommitLarge(nxpDisplay *d, int bank, i2cHandle *handle)
 {
-    int i;
-    int len;         // Input string length
-    int digit;       // Current digit
-    uint8_t code;    // Seven segment code
-
-    const int displaySize = 4;
-
-    for(i=0; i<5; i++) segmentByte[i] = 0;
-
-    len = strlen(displayStr); // Length of input string
-    digit = 0;                // No digits have been found yet
-
-    // Walk through the input string from right-to-left
-    for(i=len-1; i>=0; i--)
+    uint8_t bytesToSend[I2C_MAX_XFER];
+    int first[2], last[2];
+    int order[2];
+    int nLines = 0;
+    int n = 0;
+    int i, j, k, lcd, retval;
+
+    for(lcd = LCD_L1; lcd <= LCD_L2; lcd++)
     {
-        // Is this a period? And does a period exist at this digit location?
-        if(displayStr[i] == '.' && digit > 0)
+        if((d->frameStaged & (1 << lcd)) &&
+           lcdDiffSpan(d, lcd, bank, d->frameSeg[lcd], H4235_NBYTES, &first[lcd - LCD_L1], &last[lcd - LCD_L1]))
         {
-                // Set the period for the current digit
-                segmentByte[digit] |= 1;  // LS bit turns on the period
+            order[nLines++] = lcd;
         }
-        // Is this a comma? And does a comma exist at this digit?
-        else if(displayStr[i] == ',' && digit > 0)
+    }
+    if(nLines == 0)
+        return 0;
+    if(nLines == 2 && (last[0] - first[0]) > (last[1] - first[1]))
+    {
+        order[0] = LCD_L2;
+        order[1] = LCD_L1;
+    }
+
+    if(bank != d->frontBank[0] || (d->bankLost & 1))
+        n = nxpBankCmd(bytesToSend, n, LCD_L1, bank, d->frontBank[0], 0);
+
+    for(i = 0; i < nLines; i++)
+    {
+        lcd = order[i];
+        k = lcd - LCD_L1;
+        bytesToSend[n++] = 0x80;                          // Control byte: Command follows
+        bytesToSend[n++] = (lcd == LCD_L1) ? 0xe1 : 0xe0; // Device address for the line
+        bytesToSend[n++] = 0x80;                          // Control byte: Command follows
+        bytesToSend[n++] = first[k] * 8;                  // Data pointer
+        if(i < nLines - 1)
         {
-                // Set the comma segment for the current digit
-                segmentByte[4] |= (0x04 >> (digit-1));
+            for(j = first[k]; j <= last[k]; j++)
+            {
+                bytesToSend[n++] = 0xc0;                  // Control byte: one data byte, more follow
+                bytesToSend[n++] = d->frameSeg[lcd][j];
+            }
         }
-        // Not a comma or period - try to get a 7-segment code for this char
         else
         {
-            code = sevenSegCode(displayStr[i]);
-            if(code != 0xff)             // A supported digit or character?
-            {
-                digit++;                 // Count the valid digits
-                if(digit > displaySize)  // Any room left to continue?
-                    break;               // If not, quit.
-
-                // Set the segments to display this digit
-                segmentByte[digit-1] |= code;
-            }
+            bytesToSend[n++] = 0x40;                      // Control byte: Data follows
+            for(j = first[k]; j <= last[k]; j++)
+                bytesToSend[n++] = d->frameSeg[lcd][j];
         }
     }
+
+    retval = i2cSubmit(d->bus, d->saLarge, bytesToSend, n, 0, 0, handle);
+    if(retval) return retval;
+    d->bankLost &= ~1;
+
+    for(i = 0; i < nLines; i++)
+    {
+        lcd = order[i];
+        k = lcd - LCD_L1;
+        memcpy(&d->shadow[lcd].seg[bank][first[k]], &d->frameSeg[lcd][first[k]], last[k] - first[k] + 1);
+        d->shadow[lcd].valid |= 1 << bank;
+        d->shadow[lcd].last = *handle;
+    }
     return 0;
 }
 
 
-int h4235_SetSegments(const char *displayStr,   // String to display
-                      uint8_t segmentByte[8])   // 60 bits (7.5 bytes) of segment data
+// smallSplit - Whether S2 is missing between a fitted S1 and S3, so
+//              frameCommitSmall() can need two transactions
+//
+static int smallSplit(const nxpDisplay *d)
 {
-    int i;
-    int len;         // Input string length
-    int digit;       // Current digit
-    uint8_t code;    // Seven segment code
-
-    for(i=0; i<8; i++) segmentByte[i] = 0;
-
-    len = strlen(displayStr); // Length of input string
+    return (d->lcds & GROUP_SMALL) == ((1 << LCD_S1) | (1 << LCD_S3));
+}
 
-    // Start "digit" at 7 - one past the right-most digit for the H4235
-    digit = 7;
 
-    // Walk through the input string from right-to-left.
-    for(i=len-1; i>=0; i--)
+// frameCommitSmall
+//
+// Queue the staged H4198s as one transaction to the PCF85176s (saSmall).
+// The PCF85176 has no control byte: once the last command is sent, the
+// rest of the transaction is data. But in a cascade, when the data
+// pointer runs off the end of one device's RAM the subaddress counter
+// moves on to the next device, so the three 5-byte images form one
+// 15-byte address space. We send a single run from the first changed
+// byte to the last; bytes in between that didn't change come from the
+// shadows. As for frameCommitLarge(), the data goes to RAM bank 'bank'.
+//
+// A run can't cross an LCD that isn't fitted (there's no shadow to fill
+// it from, and no device to take it), so with S1 and S3 but no S2 there
+// may be two runs, each its own transaction. Both are queued, or neither.
+//
+static int frameCommitSmall(nxpDisplay *d, int bank, i2cHandle *handle)
+{
+    uint8_t bytesToSend[I2C_MAX_XFER];
+    uint8_t image[3 * H4198_NBYTES];
+    int runFirst[2], runLast[2];     // Changed bytes per run, over all 3
+    int runs = 0;
+    int open = 0;
+    int first, last;
+    int n, r;
+    int i, lcd, retval;
+
+    for(lcd = LCD_S1; lcd <= LCD_S3; lcd++)
     {
-        // Is this a period, and does this position have a period?
-        if(displayStr[i] == '.' && digit < 7)
+        i = (lcd - LCD_S1) * H4198_NBYTES;
+        if(!(d->lcds & (1 << lcd)))       // Not fitted: ends any run
         {
-                // Set the period for the current digit
-                segmentByte[digit-2] |= 1;  // LS bit turns on the period
+            runs += open;
+            open = 0;
         }
-        // Is this a comma?
-        else if(displayStr[i] == ',' && digit < 7)
+        else if((d->frameStaged & (1 << lcd)) &&
+                lcdDiffSpan(d, lcd, bank, d->frameSeg[lcd], H4198_NBYTES, &first, &last))
         {
-            segmentByte[6] |= (0x20 << (6-digit));  // Set the comma segment
+            memcpy(&image[i], d->frameSeg[lcd], H4198_NBYTES);
+            if(!open) runFirst[runs] = i + first;
+            runLast[runs] = i + last;
+            open = 1;
         }
-        // else, we assume this is a digit/char
         else
         {
-            code = sevenSegCode(displayStr[i]);
-            if(code != 0xff)             // A supported digit or char?
-            {
-                digit--;                 // Update our current working digit
-                if(digit < 1)            // Any room left to continue?
-                    break;               // If not, quit.
-
-                // Set the segments to display this digit
-                segmentByte[digit-1] |= code;
-            }
+            memcpy(&image[i], d->shadow[lcd].seg[bank], H4198_NBYTES);
         }
     }
+    runs += open;
+    if(runs == 0)
+        return 0;
+    if(I2C_QUEUE_DEPTH - i2cPending(d->bus) < runs)
+        return I2C_ERR_QUEUE_FULL;
+
+    for(r = 0; r < runs; r++)
+    {
+        n = 0;
+        if(r == 0 && (bank != d->frontBank[1] || (d->bankLost & 2)))
+            n = nxpBankCmd(bytesToSend, n, LCD_S1, bank, d->frontBank[1], 0);
+        bytesToSend[n++] = 0x80 | ((runFirst[r] % H4198_NBYTES) * 8);  // Data pointer; More commands follow
+        bytesToSend[n++] = 0x60 | (runFirst[r] / H4198_NBYTES);        // Device address; data follows
+        for(i = runFirst[r]; i <= runLast[r]; i++)
+            bytesToSend[n++] = image[i];
+
+        retval = i2cSubmit(d->bus, d->saSmall, bytesToSend, n, 0, 0, handle);
+        if(retval) return retval;
+        d->bankLost &= ~2;
 
+        for(lcd = LCD_S1; lcd <= LCD_S3; lcd++)
+        {
+            i = (lcd - LCD_S1) * H4198_NBYTES;
+            if(!(d->lcds & (1 << lcd)) || i + H4198_NBYTES <= runFirst[r] || i > runLast[r])
+                continue;
+            memcpy(d->shadow[lcd].seg[bank], &image[i], H4198_NBYTES);
+            if(d->frameStaged & (1 << lcd))
+                d->shadow[lcd].valid |= 1 << bank;
+            d->shadow[lcd].last = *handle;
+        }
+    }
     return 0;
 }
 
 
-// lcdWrite - Top level routine to write a string to the
-//            H4235 or one of the H4198 LCDs.
+// frameCommitFlip
+//
+// Double buffered commit of one group's staged LCDs (g: 0 large, 1
+// small): write the hidden bank, then queue the bank select that puts it
+// on the glass. The flip shows every LCD in the group, so the hidden bank
+// is brought up to date for all of them; the unstaged ones carry over
+// what's showing now. (The hidden bank holds the frame before last, so
+// that's the bytes that changed last time.) Nothing is sent if the
+// staged data is already showing. done/ctx go with the flip.
 //
-int lcdWrite(int lcd,  // The LCD to write to: LCD_L1 ... LCD_S3
-             char *s)  // The string to write
+static int frameCommitFlip(nxpDisplay *d, int g, i2cCallback done, void *ctx, i2cHandle *handle)
 {
-    uint8_t segmentData[32];    // Temp area for raw segment data
-    int retval;
+    uint8_t bytesToSend[2];
+    uint8_t staged = d->frameStaged;
+    int group = g ? GROUP_SMALL : GROUP_LARGE;
+    int nBytes = g ? H4198_NBYTES : H4235_NBYTES;
+    int front = d->frontBank[g];
+    int back = front ^ 1;
+    int changed = 0;
+    int n, first, last, lcd, retval;
+    i2cHandle h;
+
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if((group & staged & (1 << lcd)) &&
+           lcdDiffSpan(d, lcd, front, d->frameSeg[lcd], nBytes, &first, &last))
+            changed = 1;
+    }
+    if(!changed)
+        return 0;
 
-    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    // The write(s) and the flip go together, or not at all
+    if(I2C_QUEUE_DEPTH - i2cPending(d->bus) < 2 + (g && smallSplit(d)))
+        return I2C_ERR_QUEUE_FULL;
 
-    if(lcd == LCD_L1 || lcd == LCD_L2)          // Is this the H4235?
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
     {
-        // Prepare the raw segment data for an H4235
-        retval = h4235_SetSegments(s, segmentData);
-        if(retval) return retval;
+        if((group & (1 << lcd)) && !(staged & (1 << lcd)))
+        {
+            memcpy(d->frameSeg[lcd], d->shadow[lcd].seg[front], nBytes);
+            d->frameStaged |= 1 << lcd;
+        }
+    }
+    retval = g ? frameCommitSmall(d, back, &h) : frameCommitLarge(d, back, &h);
+    d->frameStaged = staged;
+    if(retval) return retval;
 
-        // Write to the appropriate line of the H4235
-        if(lcd == LCD_L1) retval = h4235_Write(1, segmentData);
-        else              retval = h4235_Write(2, segmentData);
+    n = nxpBankCmd(bytesToSend, 0, g ? LCD_S1 : LCD_L1, back, back, 1);
+    retval = i2cSubmit(d->bus, g ? d->saSmall : d->saLarge, bytesToSend, n, done, ctx, &h);
+    if(retval) return retval;   // Hidden bank written; the next commit just flips
+    d->frontBank[g] = back;
+    d->bankLost &= ~(1 << g);
 
-        if(retval) return retval;
-    }
-    else  // One of the H4198s
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
     {
-        retval = h4198_SetSegments(s, segmentData);
-        if(retval) return retval;
+        if(group & (1 << lcd))
+            d->shadow[lcd].last = h;
+    }
+    if(handle) *handle = h;
+    return 0;
+}
 
-        if(lcd == LCD_S1)      retval = h4198_Write(1, segmentData);
-        else if(lcd == LCD_S2) retval = h4198_Write(2, segmentData);
-        else                    retval = h4198_Write(3, segmentData);
 
-        if(retval) return retval;
+// lcdCommitFrame
+//
+// Send everything staged since lcdBeginFrame(): at most one i2c
+// transaction per controller address, so values on the two H4235 lines
+// (or on the H4198s) change together on the glass. Only changed bytes
+// are sent, as for lcdWrite(). When double buffered, each address also
+// gets a flip (see frameCommitFlip()).
+//
+// *handle (if non-null) is set to the last transaction queued, which
+// completes after all of the frame's others; I2C_HANDLE_NONE if nothing
+// needed sending.
+//
+// When coalescing, and handle is 0, the frame just replaces what's
+// waiting for its LCDs, and goes with the next flush (as one frame).
+//
+// Returns 0 once queued; Error code otherwise. Staged LCDs that weren't
+// queued keep their old shadows, so they'll go out with the next write.
+//
+int lcdCommitFrame(nxpDisplay *d, i2cHandle *handle)
+{
+    CPU_VAR(was)
+    int lcd, retval;
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    if((d->refreshMs || d->lampOn) && !handle)
+    {
+        d->frameOpen = 0;
+        for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+        {
+            if(d->frameStaged & (1 << lcd))
+                memcpy(d->pendSeg[lcd], d->frameSeg[lcd], sizeof(d->pendSeg[lcd]));
+        }
+        d->pending |= d->frameStaged;
+        d->frameStaged = 0;
+        retval = lcdFlushArm(d);
+    }
+    else
+    {
+        if(d->refreshMs || d->lampOn)
+            d->pending &= ~d->frameStaged;
+        retval = frameCommit(d, handle);
     }
+    CPU_LEAVE(was);
+    return retval;
+}
 
-    return 0;  // Success
-}
-
-
-/* 
-7-segment codes.
-Dig   gfedcba abcdefg
----   ------- -------
- 0     0x3F    0x7E
- 1     0x06    0x30
- 2     0x5B    0x6D
- 3     0x4F    0x79
- 4     0x66    0x33
- 5     0x6D    0x5B
- 6     0x7D    0x5F
- 7     0x07    0x70
- 8     0x7F    0x7F
- 9     0x6F    0x7B
- A     0x77    0x77
- b     0x7C    0x1F
- C     0x39    0x4E
- d     0x5E    0x3D
- E     0x79    0x4F
- F     0x71    0x47
-
- G     0x6f    0x7B;
- H     0x76    0x37;
- I     0x06    0x30;
- J     0x0e    0x38;
- K     ----    ----
- L     0x38    0x0e;
- M     ----    ----
- N     0x54    ----;  (poor char)
- O     0x3f    0x7e;
- P     0x73    0x67;
- Q     ----    ----
- R     ----    ----
- S     0x6d    0x5B;
- T     0x78    ----
- U     0x3e    0x3E;
- V     ----    ----
- W     ----    ----
- X     ----    ----
- Y     0x6e    ----
- Z     ----    ----
-' '    ----    0x00;
-'-'    0x40    0x01;
-
-*/
 
-// sevenSegCode
-//
-// Given a hexadecimal digit, return the segment code that will
-// display that digit on our LCD.  Returns 0xff if digit is not valid.
+// frameCommit - Queue the staged frame (lcdCommitFrame(), without the
+//               coalescing)
 //
-uint8_t sevenSegCode(char c)
+static int frameCommit(nxpDisplay *d, i2cHandle *handle)
 {
-    uint8_t code = 0;
+    i2cHandle h = I2C_HANDLE_NONE;
+    int first[LCD_S3 + 1], last[LCD_S3 + 1];
+    uint8_t mirror = 0;
+    int need = 4 + smallSplit(d);   // Worst case: a write and a flip per address
+    int lcd, retval;
 
-    switch(toupper(c))
-    {
-        case ' ': code = 0x00; break;
-        case '-': code = 0x40; break;
-        case '0': code = 0x3F; break;
-        case '1': code = 0x06; break;
-        case '2': code = 0x5B; break;
-        case '3': code = 0x4F; break;
-        case '4': code = 0x66; break;
-        case '5': code = 0x6D; break;
-        case '6': code = 0x7D; break;
-        case '7': code = 0x07; break;
-        case '8': code = 0x7F; break;
-        case '9': code = 0x6F; break;
-        case 'A': code = 0x77; break;
-        case 'B': code = 0x7C; break;
-        case 'C': code = 0x39; break;
-        case 'D': code = 0x5E; break;
-        case 'E': code = 0x79; break;
-        case 'F': code = 0x71; break;
-        // "extended" chars
-        case 'G': code = 0x6f; break;
-        case 'H': code = 0x76; break;
-        case 'I': code = 0x06; break;
-        case 'J': code = 0x0e; break;
-            //case 'K':
-        case 'L': code = 0x38; break;
-            //case 'M':
-        case 'N': code = 0x54; break; // this one's a stretch
-        case 'O': code = 0x3f; break;
-        case 'P': code = 0x73; break;
-            //case 'Q':
-            //case 'R':
-        case 'S': code = 0x6d; break;
-        case 'T': code = 0x78; break; // eh? 
-        case 'U': code = 0x3E; break;
-            //case 'V':
-            //case 'W':
-            //case 'X':
-        case 'Y': code = 0x6e; break;
-            //case 'Z':
+    d->frameOpen = 0;
+    lcdShadowCheck(d);
 
-        default:
-            code = 0xff; break;      // Invalid 
+    // Staged LCDs whose hidden bank has to follow along (see lcdBlink())
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if((d->frameStaged & (1 << lcd)) && lcdNeedsMirror(d, lcd) &&
+           lcdDiffSpan(d, lcd, d->frontBank[lcdGroupNum(lcd)], d->frameSeg[lcd],
+                       lcd <= LCD_L2 ? H4235_NBYTES : H4198_NBYTES, &first[lcd], &last[lcd]))
+        {
+            mirror |= 1 << lcd;
+            need += 2;
+        }
     }
 
-    if(code != 0xff) {  // Was it a valid digit?
-        code <<= 1;     // Our segments are in upper 7 bits.
+    // All or nothing, so a mirror can't be left behind
+    if(mirror && I2C_QUEUE_DEPTH - i2cPending(d->bus) < need)
+    {
+        d->frameStaged = 0;
+        return I2C_ERR_QUEUE_FULL;
     }
 
-    return code;
+    retval = lcdFlipping(d, 0) ? frameCommitFlip(d, 0, 0, 0, &h) : frameCommitLarge(d, d->frontBank[0], &h);
+    if(!retval)
+        retval = lcdFlipping(d, 1) ? frameCommitFlip(d, 1, 0, 0, &h) : frameCommitSmall(d, d->frontBank[1], &h);
+
+    for(lcd = LCD_L1; !retval && lcd <= LCD_S3; lcd++)
+    {
+        if(mirror & (1 << lcd))
+            retval = nxpWriteBack(d, lcd, d->frameSeg[lcd], first[lcd], last[lcd]);
+    }
+
+    d->frameStaged = 0;
+    if(handle) *handle = h;
+    return retval;
+}
+
+
+// Coalescing --------------------------------------------------------------
+//
+// Writes only fill the pending slots (see the notes at the top); a
+// one-shot timer then flushes them, no sooner than refreshMs after the
+// last flush. So however fast the writes come, each LCD gets at most one
+// update per refreshMs, always the latest, and a write after a quiet
+// spell isn't held back at all. The timer is only armed while something
+// is waiting.
+
+
+// lcdFlushTask - The flush timer (one-shot). A flush the queue had no
+//                room for is tried again a tick later.
+//
+static void lcdFlushTask(void *ctx)
+{
+    nxpDisplay *d = ctx;
+
+    d->flushTimer = SCHED_NO_TIMER;
+    if(d->frameOpen || lcdFlush(d, 0))
+        d->flushTimer = schedTimerStart(lcdFlushTask, d, 1, 0);
+}
+
+
+// lcdFlushArm - Arm the flush timer for what's pending, if it isn't
+//               already. With no timer to spare, flush now instead.
+//
+static int lcdFlushArm(nxpDisplay *d)
+{
+    uint32_t since;
+
+    if(d->flushTimer != SCHED_NO_TIMER || !d->pending || d->lampOn)
+        return 0;
+
+    since = schedTicks() - d->lastFlush;
+    d->flushTimer = schedTimerStart(lcdFlushTask, d,
+                                    since >= d->refreshMs ? 0 : d->refreshMs - since, 0);
+    if(d->flushTimer == SCHED_NO_TIMER)
+        return lcdFlush(d, 0);
+    return 0;
+}
+
+
+// lcdFlush - Send the pending updates, as one frame (or hold them, while
+//            a lamp test is on)
+//
+// Returns 0 once queued; Error code otherwise (they stay pending), or 1
+// if a frame is open.
+//
+int lcdFlush(nxpDisplay *d, i2cHandle *handle)
+{
+    CPU_VAR(was)
+    uint8_t pending = d->pending;
+    int lcd, retval;
+
+    if(handle) *handle = I2C_HANDLE_NONE;
+    if(d->frameOpen) return 1;
+    if(!pending || d->lampOn) return 0;
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if(pending & (1 << lcd))
+            memcpy(d->frameSeg[lcd], d->pendSeg[lcd], sizeof(d->frameSeg[lcd]));
+    }
+    d->frameStaged = pending;
+    d->pending = 0;
+
+    retval = frameCommit(d, handle);
+    if(retval)
+        d->pending |= pending;      // Whatever did go will diff to nothing
+    else
+        d->lastFlush = schedTicks();
+    CPU_LEAVE(was);
+    return retval;
+}
+
+
+// lcdRefreshRate - Set the coalescing rate (see nxp_lcd_driver.h); 0
+//                  sends anything waiting, and writes through from then on
+//
+int lcdRefreshRate(nxpDisplay *d, int hz)
+{
+    if(hz < 0 || hz > SCHED_TICK_HZ) return 1;
+
+    d->refreshMs = hz ? 1000 / hz : 0;
+    if(hz == 0)
+    {
+        schedTimerStop(d->flushTimer);
+        d->flushTimer = SCHED_NO_TIMER;
+        return lcdFlush(d, 0);
+    }
+    return 0;
+}
+
+
+// Lamp test ---------------------------------------------------------------
+//
+// The lamp patterns are a canned animation (animLampTest, in flash),
+// played like any other, so they go through the shadows. While it
+// plays, writes are held in the pending slots, as when coalescing (even
+// with coalescing off), and the glass's content before the test is put
+// there to start with. Putting the lamps out is then just a flush: each
+// LCD goes back to the latest thing written to it.
+
+
+// lcdLampTest - Play anim over the fitted LCDs, then put them back to
+//               the content. Returns once the first frame is queued;
+//               the rest runs from the scheduler. Returns 1 if a lamp
+//               test is already on (or a frame is open, or anim has no
+//               frames).
+//
+int lcdLampTest(nxpDisplay *d, const lcdAnim *anim)
+{
+    uint8_t fitted = d->lcds & (GROUP_LARGE | GROUP_SMALL);
+    int lcd, bank, retval;
+
+    if(d->lampOn || d->frameOpen || !anim || !anim->n) return 1;
+
+    lcdShadowCheck(d);
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if(!(fitted & (1 << lcd)))
+            continue;
+        bank = d->frontBank[lcdGroupNum(lcd)];
+        if(d->pending & (1 << lcd))
+            ;   // Newer than what's showing; keep it
+        else if(d->shadow[lcd].valid & (1 << bank))
+            memcpy(d->pendSeg[lcd], d->shadow[lcd].seg[bank], sizeof(d->pendSeg[lcd]));
+        else
+            memset(d->pendSeg[lcd], 0, sizeof(d->pendSeg[lcd]));
+    }
+    d->pending |= fitted;
+    d->lampOn = 1;
+
+    retval = animStart(d, anim, lcdLampTask, d);
+    if(retval)
+        lcdLampTask(d);     // Put back whatever did go out
+    return retval;
+}
+
+
+// lcdLampTask - End of the lamp test (the animation's done): flush
+//               what's waiting (at once, or when the refresh rate
+//               allows)
+//
+static void lcdLampTask(void *ctx)
+{
+    nxpDisplay *d = ctx;
+
+    d->lampOn = 0;
+    lcdFlushArm(d);
+}
+
+
+// Blinking --------------------------------------------------------------
+//
+// Both controllers have a blink engine, set by the blink-select command
+// (C111 0ABB on the PCF85176, 1111 0ABB on the PCF85134): BB picks the
+// rate, and with A clear the whole display blinks off and on. That
+// command goes to every controller at an address, though, so it can only
+// blink a whole group (all three H4198s, or both H4235 lines).
+//
+// To blink some LCDs of a group but not the others, we use alternate RAM
+// bank blinking (A set): each controller then flips between its RAM
+// bank 0 (row 0, in static mode) and bank 1 (row 2) at the blink rate.
+// A blinking LCD gets a blank hidden bank (the one not on the glass); the
+// rest of the group get a copy of the shown bank there, so they look
+// steady. lcdWrite() keeps those copies up to date for as long as the
+// blink lasts (one more transaction per changed write; none at all when
+// no LCD blinks). That ties up both banks, so a group blinking this way
+// isn't double buffered until the blink ends.
+
+
+// lcdGroup - Group mask (GROUP_LARGE/GROUP_SMALL) for an LCD
+//
+static int lcdGroup(int lcd)
+{
+    return (lcd == LCD_L1 || lcd == LCD_L2) ? GROUP_LARGE : GROUP_SMALL;
+}
+
+
+// lcdGroupNum - Group number for an LCD: 0 large, 1 small (indexes the
+//               per-group arrays)
+//
+static int lcdGroupNum(int lcd)
+{
+    return (lcd == LCD_L1 || lcd == LCD_L2) ? 0 : 1;
+}
+
+
+// lcdAltBlinking - Is group 'group' (mask) using alternate bank blinking?
+//
+static int lcdAltBlinking(nxpDisplay *d, int group)
+{
+    return (d->blinkMask & group) && (d->blinkMask & group) != group;
+}
+
+
+// lcdNeedsMirror - Does this LCD's hidden bank have to copy the shown
+//                  one? (Only while others in its group are blinking,
+//                  and it isn't.)
+//
+static int lcdNeedsMirror(nxpDisplay *d, int lcd)
+{
+    return lcdAltBlinking(d, lcdGroup(lcd)) && !(d->blinkMask & (1 << lcd));
+}
+
+
+// nxpWriteBack - Queue segment bytes first..last into the hidden RAM bank
+//                of one LCD, then select the shown bank for input again
+//                (for everything else). Two transactions, as display
+//                data runs to the stop; both are queued, or neither.
+//
+static int nxpWriteBack(nxpDisplay *d, int lcd, const uint8_t seg[], int first, int last)
+{
+    uint8_t bytesToSend[2];
+    int g = lcdGroupNum(lcd);
+    int back = d->frontBank[g] ^ 1;
+    int n, retval;
+
+    if(I2C_QUEUE_DEPTH - i2cPending(d->bus) < 2)
+        return I2C_ERR_QUEUE_FULL;
+
+    retval = nxpWriteSpan(d, lcd, back, seg, first, last, 0, 0, 0);
+    if(retval) return retval;
+    memcpy(&d->shadow[lcd].seg[back][first], &seg[first], last - first + 1);
+    if(first == 0 && last == (g ? H4198_NBYTES : H4235_NBYTES) - 1)
+        d->shadow[lcd].valid |= 1 << back;
+
+    n = nxpBankCmd(bytesToSend, 0, lcd, d->frontBank[g], d->frontBank[g], 1);
+    return i2cSubmit(d->bus, g ? d->saSmall : d->saLarge, bytesToSend, n, 0, 0, 0);
+}
+
+
+// lcdBlink - Blink one LCD (or stop it blinking)
+//
+// See the notes above. The rate is shared by the group, so the last rate
+// set applies to every blinking LCD in it. Setting the whole group
+// blinking uses plain blinking (no bank copies needed).
+//
+// Returns 0 once queued; Error code otherwise (nothing is changed; try
+// again).
+//
+int lcdBlink(nxpDisplay *d, int lcd, int rate)
+{
+    uint8_t blank[8];
+    const uint8_t *img;
+    uint8_t mask, group, sa;
+    uint8_t cmd[2];
+    int alt, members, g, nBytes, first, last;
+    int n = 0;
+    int i;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    if(!(d->lcds & (1 << lcd))) return 1;       // Not fitted in this set
+    if(rate < LCD_BLINK_OFF || rate > LCD_BLINK_0_5HZ) return 1;
+
+    group = lcdGroup(lcd);
+    sa = (group == GROUP_LARGE) ? d->saLarge : d->saSmall;
+    members = (group == GROUP_LARGE) ? 2 : 3;
+    g = lcdGroupNum(lcd);
+    nBytes = (group == GROUP_LARGE) ? H4235_NBYTES : H4198_NBYTES;
+    mask = rate ? (d->blinkMask | (1 << lcd)) : (d->blinkMask & ~(1 << lcd));
+    alt = (mask & group) && (mask & group) != group;
+
+    // Room for the command, and the hidden bank images (two transactions each)?
+    if(I2C_QUEUE_DEPTH - i2cPending(d->bus) < 1 + (alt ? 2 * members : 0))
+        return I2C_ERR_QUEUE_FULL;
+
+    d->blinkMask = mask;
+    if(rate)
+        d->blinkRate[g] = rate;
+    else if(mask & group)
+        rate = d->blinkRate[g];    // The rest of the group keeps blinking
+    else
+        d->blinkRate[g] = LCD_BLINK_OFF;
+    lcdShadowCheck(d);
+
+    if(alt)
+    {
+        // Some of the group: alternate bank blinking. Blank the hidden
+        // bank of the blinkers, copy the shown bank to it for the rest
+        // (only what isn't there already).
+        memset(blank, 0, sizeof(blank));
+        for(i = LCD_L1; i <= LCD_S3; i++)
+        {
+            if(!(group & (1 << i)))
+                continue;
+            img = (mask & (1 << i)) ? blank : d->shadow[i].seg[d->frontBank[g]];
+            if(lcdDiffSpan(d, i, d->frontBank[g] ^ 1, img, nBytes, &first, &last))
+                nxpWriteBack(d, i, img, first, last);
+        }
+        rate |= 0x04;   // A: alternate RAM bank blinking
+    }
+
+    if(sa == d->saLarge)
+        cmd[n++] = 0x00;                    // Control byte: (last) command follows
+    cmd[n++] = ((sa == d->saLarge) ? 0xf0 : 0x70) | rate;   // Blink select
+
+    return i2cSubmit(d->bus, sa, cmd, n, 0, 0, 0);
+}
+
+
+// Double buffering -------------------------------------------------------
+//
+// In static drive mode each controller has two RAM banks (rows 0 and 2),
+// with separate input and output bank selectors (bank select: C111 10IO
+// on the PCF85176, 1111 10IO on the PCF85134). When double buffered, a
+// frame is written into the hidden bank (input bank != output bank), and
+// a one-byte bank select then swaps it onto the glass. However long the
+// write takes, the glass only ever shows whole frames.
+//
+// Like blinking, bank selection is per address, so a flip shows every
+// LCD in the group; frameCommitFlip() keeps the hidden bank of the ones
+// that didn't change in step with the glass. Outside of a write to the
+// hidden bank, the input bank is the one on the glass (frontBank[]), so
+// plain writes, and the raw h4198/h4235_Write()s, land there as before.
+
+
+// nxpBankCmd - Put a bank select command (input bank 'in', output bank
+//              'out') for the LCD's controller type at bytes[n]; 'last'
+//              if no more commands follow. Returns the new length.
+//
+static int nxpBankCmd(uint8_t bytes[], int n, int lcd, int in, int out, int last)
+{
+    if(lcd == LCD_L1 || lcd == LCD_L2)   // PCF85134
+    {
+        bytes[n++] = last ? 0x00 : 0x80;                // Control byte: (last) command follows
+        bytes[n++] = 0xf8 | (in << 1) | out;            // Bank select
+    }
+    else                                 // PCF85176
+        bytes[n++] = (last ? 0x78 : 0xf8) | (in << 1) | out;   // Bank select; (no) more commands follow
+    return n;
+}
+
+
+// lcdFlipping - Are group g's writes double buffered just now?
+//
+static int lcdFlipping(nxpDisplay *d, int g)
+{
+    return d->dblBuf && !lcdAltBlinking(d, g ? GROUP_SMALL : GROUP_LARGE);
+}
+
+
+// lcdDoubleBuffer - Turn double buffering on or off (see notes above)
+//
+// Takes effect from the next write; whichever bank is showing stays.
+// The LCD_DOUBLE_BUFFER option (product_config.h) sets the default.
+//
+void lcdDoubleBuffer(nxpDisplay *d, int on)
+{
+    d->dblBuf = on ? 1 : 0;
+}
+
+
+// nxpRawWrite
+//
+// Write n data bytes to the LCD driver IC, via i2c bus, and wait for
+// the transaction to finish. This includes preceding the bytes with an
+// i2c start condition, and following the bytes with an i2c stop
+// condition.
+//
+// This is the old blocking interface, now a thin wrapper on the queued
+// i2c_master engine; anything already queued goes out first.
+//
+// Inputs:
+//   sa   - I2C Slave address (we use 2: 0x70 and 0x72)
+//   data - Byte array data to send
+//   n    - Length of byte array
+//
+// Returns 0 on success; Error code otherwise (I2C_ERR_xxx)
+//
+int nxpRawWrite(nxpDisplay *d, uint8_t sa, uint8_t data[], int n)
+{
+    PERF_VAR(t0)
+    i2cHandle h;
+    int retval;
+
+    PERF_MARK(t0);
+    retval = i2cSubmit(d->bus, sa, data, n, 0, 0, &h);
+    if(retval == 0)
+        retval = i2cWait(d->bus, h);
+    PERF_END(rawWrite, t0);
+
+    return retval;
+}
+
+
+
+// h4235SetSegments / h4198SetSegments
+//
+// Given a string to display (displayStr), prepare the bytes
+// that will be sent to the LCD driver to show that string.
+//
+// Both are the generic encoder (glassEncode(), glass.h) with their
+// glass's descriptor; see the segment maps at the top of this file.
+//
+// Inputs:
+//   displayStr - The string to display, with optional decimal
+//                points or commas.
+//                Example input strings:
+//                    "1.23"
+//                    "123"
+//                    " 5,95"
+// Outputs:
+//   segmentByte  - Array of bytes that, when sent to the LCD
+//                driver, will energize the correct segments to
+//                display the input string.
+//
+// Returns 0 on success; Error code otherwise
+//
+
+// H4198: digit 1 (right) is byte 0, with no period or comma; commas at
+// S37,38,39 (byte 4)
+static const glassDesc h4198Glass =
+{
+    4, H4198_NBYTES, 4,
+    {
+        { 0, 0x00, 0x00 },
+        { 1, 0x01, 0x04 },
+        { 2, 0x01, 0x02 },
+        { 3, 0x01, 0x01 },
+    }
+};
+
+// H4235 line: digit 1 (left) is byte 0, so the right-most is byte 5,
+// with no period or comma; commas at S48,49,50 (byte 6)
+static const glassDesc h4235Glass =
+{
+    6, H4235_NBYTES, 6,
+    {
+        { 5, 0x00, 0x00 },
+        { 4, 0x01, 0x20 },
+        { 3, 0x01, 0x40 },
+        { 2, 0x01, 0x80 },
+        { 1, 0x01, 0x00 },
+        { 0, 0x01, 0x00 },
+    }
+};
+
+
+int h4198_SetSegments(const char *displayStr,   // Display string to process
+                      uint8_t segmentByte[5])   // Return 5 data bytes (40segments)
+{
+    return glassEncode(&h4198Glass, displayStr, segmentByte);
+}
+
+
+int h4235_SetSegments(const char *displayStr,   // String to display
+                      uint8_t segmentByte[8])   // 60 bits (7.5 bytes) of segment data
+{
+    segmentByte[7] = 0;                         // n/c, and never sent
+    return glassEncode(&h4235Glass, displayStr, segmentByte);
+}
+
+
+// lcdWriteAsync - Top level routine to write a string to the
+//                 H4235 or one of the H4198 LCDs.
+//
+// The segment data is prepared here and compared against what was last
+// sent to that LCD; only the changed bytes are queued to the i2c engine,
+// and nothing at all if the image is unchanged. This returns without
+// waiting for the bus. Completion can be picked up via the done callback
+// (from the i2c interrupt), or by polling *handle with i2cPoll() or
+// i2cWait(). Any of done, ctx and handle may be 0.
+//
+// Returns 0 once queued; Error code otherwise.
+//
+int lcdWriteAsync(nxpDisplay *d,
+                  int lcd,           // The LCD to write to: LCD_L1 ... LCD_S3
+                  const char *s,     // The string to write
+                  i2cCallback done, void *ctx, i2cHandle *handle)
+{
+    PERF_VAR(t0)
+    CPU_VAR(was)
+    uint8_t segmentData[32];    // Temp area for raw segment data
+    int nBytes;
+    int retval;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    if(!(d->lcds & (1 << lcd))) return 1;       // Not fitted in this set
+
+    d->counter[lcd].on = 0;                     // Any counter or marquee is overwritten
+    lcdScrollStop(d, lcd);
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    PERF_MARK(t0);
+    if(lcd == LCD_L1 || lcd == LCD_L2)          // Is this the H4235?
+    {
+        // Prepare the raw segment data for an H4235
+        retval = h4235_SetSegments(s, segmentData);
+        nBytes = h4235Glass.nBytes;
+    }
+    else  // One of the H4198s
+    {
+        retval = h4198_SetSegments(s, segmentData);
+        nBytes = h4198Glass.nBytes;
+    }
+    PERF_END(encode, t0);
+
+    if(retval == 0)
+        retval = lcdWriteDiff(d, lcd, segmentData, nBytes, done, ctx, handle);
+    PERF_END(lcdWrite, t0);
+    CPU_LEAVE(was);
+
+    return retval;
+}
+
+
+// lcdWrite - Queue a string for one of the LCDs, without waiting for
+//            the bus. Returns 0 once queued.
+//
+int lcdWrite(nxpDisplay *d, int lcd, char *s)
+{
+    return lcdWriteAsync(d, lcd, s, 0, 0, 0);
+}
+
+
+// lcdWriteSync - Write a string to one of the LCDs, and wait until it has
+//                gone out on the bus (the original lcdWrite behaviour).
+//
+// Returns 0 on success; Error code otherwise.
+//
+int lcdWriteSync(nxpDisplay *d, int lcd, char *s)
+{
+    i2cHandle h;
+    int retval;
+
+    retval = lcdWriteAsync(d, lcd, s, 0, 0, &h);
+    if(retval) return retval;
+
+    return i2cWait(d->bus, h);
+}
+
+
+// Counter mode ------------------------------------------------------------
+//
+// A counter keeps the value as decimal digits (bcd[], right-most first)
+// alongside its segment image. Rendering follows fmtFixed(): digits above
+// the highest non-zero one are blank, except the ones up to and including
+// the one ahead of the point, and the period goes on that one. Digits
+// that don't fit on the glass fall off the left, as for lcdWrite(); if a
+// carry runs off the end, the counter just starts over from the value.
+// No commas are lit.
+
+
+// counterGlass - The glass descriptor for an LCD
+//
+static const glassDesc *counterGlass(int lcd)
+{
+    return (lcd == LCD_L1 || lcd == LCD_L2) ? &h4235Glass : &h4198Glass;
+}
+
+
+// counterDigit - Render digit 'pos' of a counter into its segment image
+//
+static void counterDigit(lcdCounter *c, const glassDesc *glass, int pos)
+{
+    uint8_t code = 0;
+
+    if(pos <= c->top || pos <= c->decimals)      // Not a leading blank
+        code = glyphTable['0' + c->bcd[pos]];
+    if(c->decimals && pos == c->decimals)
+        code |= glass->digit[pos].period;
+    c->seg[glass->digit[pos].byte] = code;
+}
+
+
+// lcdCounterStart - Enter counter mode, showing 'value' (see above)
+//
+int lcdCounterStart(nxpDisplay *d, int lcd, uint32_t value, int decimals)
+{
+    CPU_VAR(was)
+    const glassDesc *glass;
+    lcdCounter *c;
+    int pos, retval;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    if(!(d->lcds & (1 << lcd))) return 1;       // Not fitted in this set
+    glass = counterGlass(lcd);
+    if(decimals < 0 || decimals >= glass->digits) return 1;
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    lcdScrollStop(d, lcd);
+    c = &d->counter[lcd];
+    c->value = value;
+    c->decimals = decimals;
+    c->top = 0;
+    for(pos = 0; pos < glass->digits; pos++)
+    {
+        c->bcd[pos] = value % 10;
+        value /= 10;
+        if(c->bcd[pos])
+            c->top = pos;
+    }
+    if(value)                                   // More digits than fit: none blank
+        c->top = glass->digits - 1;
+    memset(c->seg, 0, sizeof(c->seg));
+    for(pos = 0; pos < glass->digits; pos++)
+        counterDigit(c, glass, pos);
+
+    c->on = 1;
+    retval = lcdWriteDiff(d, lcd, c->seg, glass->nBytes, 0, 0, 0);
+    CPU_LEAVE(was);
+    return retval;
+}
+
+
+// lcdCounterAdd - Step a counter up by 'delta'
+//
+// The carry runs only as far as it has to; just the digits it touched
+// are re-rendered, and only the bytes that changed are queued.
+//
+int lcdCounterAdd(nxpDisplay *d, int lcd, uint32_t delta)
+{
+    CPU_VAR(was)
+    const glassDesc *glass;
+    lcdCounter *c;
+    uint32_t carry = delta;
+    int pos, n, retval;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    c = &d->counter[lcd];
+    if(!c->on) return 1;                        // Not in counter mode
+    if(delta == 0) return 0;
+
+    glass = counterGlass(lcd);
+    c->value += delta;
+
+    // Long addition, least significant digit first
+    for(n = 0; carry; n++)
+    {
+        if(n == glass->digits)                  // Off the end of the glass
+            return lcdCounterStart(d, lcd, c->value, c->decimals);
+        carry += c->bcd[n];
+        c->bcd[n] = carry % 10;
+        carry /= 10;
+        if(c->bcd[n] && n > c->top)
+            c->top = n;
+    }
+
+    // Digits 0..n-1 changed (the top, and so the blanking, can only have
+    // moved up among them)
+    CPU_ENTER(was, CPU_DISPLAY);
+    for(pos = 0; pos < n; pos++)
+        counterDigit(c, glass, pos);
+
+    retval = lcdWriteDiff(d, lcd, c->seg, glass->nBytes, 0, 0, 0);
+    CPU_LEAVE(was);
+    return retval;
+}
+
+
+// lcdCounterSet - Move a counter to 'value'
+//
+int lcdCounterSet(nxpDisplay *d, int lcd, uint32_t value)
+{
+    lcdCounter *c;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    c = &d->counter[lcd];
+    if(!c->on) return 1;                        // Not in counter mode
+    if(value >= c->value)
+        return lcdCounterAdd(d, lcd, value - c->value);
+    return lcdCounterStart(d, lcd, value, c->decimals);
+}
+
+
+// sevenSegCode
+//
+// Given a hexadecimal digit, return the segment code that will
+// display that digit on our LCD.  Returns 0xff if digit is not valid.
+// (Upper/lower case both work; see SEG_GLYPHS in glyphs.h for the set.)
+//
+uint8_t sevenSegCode(char c)
+{
+    uint8_t code = glyphTable[(uint8_t)c];
+
+    if(code & GLYPH_CLASS)  // Not a glyph ('.', ',' or invalid)?
+        code = 0xff;
+
+    return code;
+}
+
+
+// Marquee -----------------------------------------------------------------
+//
+// The text is encoded once into a stream of glyphs: one cell per glyph,
+// its segment code with the period in bit 0 (as in glyphRing), and a
+// bit per glyph for a comma after it. The window is the glass's digits;
+// pos is how many glyphs have come into it from the right, so digit n
+// (0 = right-most) shows glyph pos - 1 - n, or a blank off either end of
+// the stream. A step is then a handful of table reads per digit, and a
+// diffed write of whatever changed.
+
+
+// scrollEncode - Encode the text into the marquee's stream. Returns 1 if
+//                it's too long.
+//
+static int scrollEncode(lcdScroller *s, const char *text)
+{
+    const uint8_t *p = (const uint8_t *)text;
+    uint8_t code;
+    int k = 0;
+
+    memset(s->comma, 0, sizeof(s->comma));
+    while(*p)
+    {
+        code = glyphTable[*p++];
+        if(code == GLYPH_INVALID)                   // Not displayable; skip it
+            continue;
+        if(k == LCD_SCROLL_MAX && !(code & GLYPH_CLASS))
+            return 1;
+        if(k == 0 && (code & GLYPH_CLASS))          // Leading punctuation: on a blank
+            s->cell[k++] = 0;
+
+        if(!(code & GLYPH_CLASS))                   // A glyph
+            s->cell[k++] = code;
+        else if(code == GLYPH_PERIOD)               // Period on the glyph before
+            s->cell[k-1] |= 1;
+        else                                        // Comma on the glyph before
+            s->comma[(k-1) >> 3] |= 1 << ((k-1) & 7);
+    }
+    s->len = k;
+    return 0;
+}
+
+
+// scrollRender - Render the window at s->pos into the segment image
+//
+static void scrollRender(lcdScroller *s, const glassDesc *glass)
+{
+    uint8_t cell, commas = 0;
+    int n, g;
+
+    memset(s->seg, 0, sizeof(s->seg));
+    for(n = 0; n < glass->digits; n++)
+    {
+        g = s->pos - 1 - n;
+        if(g < 0 || g >= s->len)
+            continue;
+        cell = s->cell[g];
+        s->seg[glass->digit[n].byte] |= (cell & 0xfe) | ((cell & 1) * glass->digit[n].period);
+        if(s->comma[g >> 3] & (1 << (g & 7)))
+            commas |= glass->digit[n].comma;
+    }
+    s->seg[glass->commaByte] |= commas;
+}
+
+
+// lcdScrollTask - The step timer: move the window on a glyph, back to
+//                 the start once the text has gone off the left
+//
+static void lcdScrollTask(void *ctx)
+{
+    CPU_VAR(was)
+    lcdScroller *s = ctx;
+    const glassDesc *glass = counterGlass(s->lcd);
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    if(++s->pos >= s->len + glass->digits)
+        s->pos = 0;
+    scrollRender(s, glass);
+    lcdWriteDiff(s->d, s->lcd, s->seg, glass->nBytes, 0, 0, 0);
+    CPU_LEAVE(was);
+}
+
+
+// lcdScrollStop - End the marquee on an LCD, if one is running
+//
+static void lcdScrollStop(nxpDisplay *d, int lcd)
+{
+    lcdScroller *s = &d->scroll[lcd];
+
+    if(s->timer == SCHED_NO_TIMER)
+        return;
+    schedTimerStop(s->timer);
+    s->timer = SCHED_NO_TIMER;
+}
+
+
+// lcdScroll - Start (or stop) a marquee on an LCD (see nxp_lcd_driver.h)
+//
+// The first glyph comes in at the right straight away.
+//
+int lcdScroll(nxpDisplay *d, int lcd, const char *text, uint32_t stepMs)
+{
+    const glassDesc *glass;
+    lcdScroller *s;
+
+    if(lcd < LCD_L1 || lcd > LCD_S3) return 1;  // lcd number out of range?
+    if(!(d->lcds & (1 << lcd))) return 1;       // Not fitted in this set
+
+    lcdScrollStop(d, lcd);
+    if(!text || !stepMs) return 0;
+
+    s = &d->scroll[lcd];
+    if(scrollEncode(s, text)) return 1;
+    d->counter[lcd].on = 0;
+    s->d = d;
+    s->lcd = lcd;
+
+    s->timer = schedTimerStart(lcdScrollTask, s, stepMs, stepMs);
+    if(s->timer == SCHED_NO_TIMER) return 1;
+    glass = counterGlass(lcd);
+    s->pos = 1;
+    scrollRender(s, glass);
+    return lcdWriteDiff(d, lcd, s->seg, glass->nBytes, 0, 0, 0);
+}
+
+
+// Animation ---------------------------------------------------------------
+//
+// Each frame is staged as is and committed with a handle, so it goes
+// straight to the bus as one frame (not coalesced), replacing anything
+// waiting for its LCDs. A frame the queue has no room for is tried again
+// a tick later, and its time runs from when it goes.
+//
+// The lamp test (lampOn) plays the same way, but over the top: its
+// frames leave counters and marquees running (their writes wait in the
+// pending slots, with everything else), and don't take those slots'
+// content off the list.
+
+
+// animFrame - Queue one frame. Returns 0 once queued.
+//
+static int animFrame(nxpDisplay *d, const lcdAnimFrame *f)
+{
+    uint8_t lcds = f->lcds & d->lcds;
+    i2cHandle h;
+    int lcd;
+
+    if(d->frameOpen) return 1;
+
+    for(lcd = LCD_L1; lcd <= LCD_S3; lcd++)
+    {
+        if(!(lcds & (1 << lcd)))
+            continue;
+        if(!d->lampOn)
+        {
+            d->counter[lcd].on = 0;
+            lcdScrollStop(d, lcd);
+        }
+        memcpy(d->frameSeg[lcd], f->seg[lcd], sizeof(d->frameSeg[lcd]));
+    }
+    d->frameStaged = lcds;
+    return d->lampOn ? frameCommit(d, &h) : lcdCommitFrame(d, &h);
+}
+
+
+// lcdAnimTask - The frame timer (one-shot): the next frame, or the end
+//
+static void lcdAnimTask(void *ctx)
+{
+    CPU_VAR(was)
+    nxpDisplay *d = ctx;
+    const lcdAnimFrame *f;
+    uint32_t wait = 1;
+
+    d->animTimer = SCHED_NO_TIMER;
+    if(d->animIdx == d->anim->n)
+    {
+        d->anim = 0;
+        if(d->animDone)
+            d->animDone(d->animCtx);
+        return;
+    }
+
+    CPU_ENTER(was, CPU_DISPLAY);
+    f = &d->anim->frames[d->animIdx];
+    if(animFrame(d, f) == 0)
+    {
+        d->animIdx++;
+        wait = f->ms;
+    }
+    CPU_LEAVE(was);
+    d->animTimer = schedTimerStart(lcdAnimTask, d, wait, 0);
+}
+
+
+// lcdPlay - Start (or stop) an animation (see nxp_lcd_driver.h). Not
+//           while the lamp test has the glass.
+//
+int lcdPlay(nxpDisplay *d, const lcdAnim *anim, schedFunc done, void *ctx)
+{
+    if(d->lampOn) return 1;
+    return animStart(d, anim, done, ctx);
+}
+
+
+// animStart - lcdPlay(), or the lamp test's animation
+//
+static int animStart(nxpDisplay *d, const lcdAnim *anim, schedFunc done, void *ctx)
+{
+    int retval;
+
+    schedTimerStop(d->animTimer);
+    d->animTimer = SCHED_NO_TIMER;
+    d->anim = 0;
+    if(!anim || !anim->n) return 0;
+
+    retval = animFrame(d, &anim->frames[0]);
+    if(retval) return retval;
+
+    d->anim = anim;
+    d->animIdx = 1;
+    d->animDone = done;
+    d->animCtx = ctx;
+    d->animTimer = schedTimerStart(lcdAnimTask, d, anim->frames[0].ms, 0);
+    if(d->animTimer == SCHED_NO_TIMER)
+    {
+        d->anim = 0;
+        return 1;
+    }
+    return 0;
 }
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 
+#include "i2c_master.h"
+#include "sched.h"
+
 // From a software viewpoint, we have 5 LCDs:
 #define LCD_L1 1  /* Large display, line 1 (H4235, top line, 6 digits) */
 #define LCD_L2 2  /* Large display, line 2 (H4235, bottom line, 6 digits) */
@@ -15,14 +18,237 @@
 #define LCD_A1 0x70  /* H4198 displays (up to 3, with NXP PCF85176 ICs */
 #define LCD_A2 0x72  /* H4235's two sub-displays (2 NXP PCF85134 ICs */
 
-// Initialize the pic's I2C interface, and the NXP LCD control ICs.
-void nxpInit(int peripheralBusClock);
 
+// A display set: one H4235 and up to three H4198s, on one i2c bus
+// (lcd_bus.h). Every call below takes the set's nxpDisplay, so several
+// sets, each on its own bus, can be driven at once; their transfers
+// overlap on the wire.
+typedef struct
+{
+    int     bus;       // I2C bus number
+    uint8_t saSmall;   // H4198s' (PCF85176) slave address; usually LCD_A1
+    uint8_t saLarge;   // H4235's (PCF85134) slave address; usually LCD_A2
+    uint8_t lcds;      // Bit (1 << LCD_xx) per LCD fitted; NXP_ALL_LCDS for all
+} nxpConfig;
+
+#define NXP_ALL_LCDS  ((1 << LCD_L1) | (1 << LCD_L2) | (1 << LCD_S1) | (1 << LCD_S2) | (1 << LCD_S3))
+
+// Shadow of one LCD's controller RAM (private to nxp_lcd_driver.c)
+typedef struct
+{
+    uint8_t   seg[2][8];  // Segment data as last queued, per RAM bank
+    uint8_t   valid;      // Bit per bank whose seg[] matches the controller RAM
+    i2cHandle last;       // Most recent write queued for this LCD
+} lcdShadow;
+
+// Counter (odometer) state for one LCD (private to nxp_lcd_driver.c)
+typedef struct
+{
+    uint32_t  value;      // Value shown, unscaled
+    uint8_t   on;         // Non-zero while in counter mode
+    uint8_t   decimals;   // Digits after the point
+    uint8_t   top;        // Highest non-zero digit (0 if none)
+    uint8_t   bcd[8];     // Decimal digits, right-most first
+    uint8_t   seg[8];     // Segment image, as last written
+} lcdCounter;
+
+#define LCD_SCROLL_MAX  64    // Most glyphs in a marquee message
+
+// Marquee state for one LCD (private to nxp_lcd_driver.c)
+typedef struct
+{
+    struct nxpDisplay *d; // The set it's on (the step timer's context)
+    uint8_t   lcd;
+    uint8_t   len;        // Glyphs in the stream
+    uint8_t   pos;        // Glyphs into the window so far (0 .. len + digits - 1)
+    int       timer;      // Step timer (sched.h), or SCHED_NO_TIMER when stopped
+    uint8_t   cell[LCD_SCROLL_MAX];        // Segment code per glyph, period in bit 0
+    uint8_t   comma[LCD_SCROLL_MAX / 8];   // Bit per glyph with a comma after it
+    uint8_t   seg[8];     // Segment image, as last written
+} lcdScroller;
+
+// Canned animation: raw segment frames, each shown for a set time (see
+// lcdPlay()). Meant to live in flash, generated ahead of time (see
+// anim_table.h).
+typedef struct
+{
+    uint16_t  ms;                    // Time on the glass before the next frame
+    uint8_t   lcds;                  // Bit per LCD the frame writes; the rest are left alone
+    uint8_t   seg[LCD_S3 + 1][8];    // Raw segment data, per LCD (as h4235/h4198_SetSegments())
+} lcdAnimFrame;
+
+typedef struct
+{
+    const lcdAnimFrame *frames;
+    uint8_t   n;                     // Frames
+} lcdAnim;
+
+// Driver state for one display set. The fields are private to
+// nxp_lcd_driver.c; see the notes there. Give it static (zeroed) storage.
+typedef struct nxpDisplay
+{
+    int       bus;                   // From the nxpConfig
+    uint8_t   saSmall, saLarge;
+    uint8_t   lcds;
+
+    lcdShadow shadow[LCD_S3 + 1];    // Indexed by LCD_L1..LCD_S3
+    uint32_t  shadowErrors;          // i2cErrorCount() when last checked
+
+    uint8_t   blinkMask;             // Bit per LCD that is blinking
+    uint8_t   blinkRate[2];          // LCD_BLINK_xxx in use: [0] large group, [1] small group
+
+    uint8_t   dblBuf;                // Non-zero: frames go to the hidden bank, then flip
+    uint8_t   frontBank[2];          // RAM bank on the glass (the output bank), per group
+    uint8_t   bankLost;              // Bit per group (1 << n) whose bank selection is in doubt
+
+    uint8_t   initState;             // Power-up sequence step
+    int       initPbClk;
+    uint32_t  initStart;             // schedTicks() at the first init commands
+    volatile int8_t initStatus[2];   // Latest init commands' status per group (I2C_PENDING...)
+    uint8_t   initLost;              // Bit per group that didn't answer at power-up
+
+    uint8_t   lampOn;                // Non-zero during a lamp test (its animation playing)
+
+    uint8_t   speedIdx;              // Bus speed in use (index)
+    uint32_t  probeErrors;           // i2cErrorCount() before the test writes
+    uint32_t  lastXfers, lastNacks;  // i2cXferCount(), i2cNackCount() at the last check
+    int       speedTimer;            // NACK rate check (sched.h timer)
+
+    uint8_t   frameOpen;             // Non-zero while gathering a frame
+    uint8_t   frameStaged;           // Bit per LCD with staged data
+    uint8_t   frameSeg[LCD_S3 + 1][8];  // Staged segment data
+
+    lcdCounter counter[LCD_S3 + 1];  // Counter mode, per LCD
+    lcdScroller scroll[LCD_S3 + 1];  // Marquee, per LCD
+
+    const lcdAnim *anim;             // Animation playing, or 0
+    uint8_t   animIdx;               // Next frame
+    int       animTimer;             // Its time (sched.h timer), or SCHED_NO_TIMER
+    schedFunc animDone;              // Called when it has run
+    void     *animCtx;
 
-// Write a string to one of the LCDs
-int lcdWrite(int lcd,  // LCD to write to (LCD_L1, LCD_L2, LCD_S1,... )
+    uint16_t  refreshMs;             // Least time between flushes; 0 = write through
+    uint32_t  lastFlush;             // schedTicks() at the last flush
+    int       flushTimer;            // Flush to come (sched.h timer), or SCHED_NO_TIMER
+    uint8_t   pending;               // Bit per LCD with an update waiting
+    uint8_t   pendSeg[LCD_S3 + 1][8];   // The latest update, per LCD
+} nxpDisplay;
+
+
+// Initialize the pic's I2C interface, and the NXP LCD control ICs. This
+// only starts the sequence; it runs as a scheduler task (sched.h), so
+// needs schedRunOnce() called from the main loop. nxpReady() goes
+// non-zero when it's done, a few milliseconds later (the controllers are
+// polled until they answer, rather than waited for). A lamp test
+// follows if LCD_LAMP_TEST is set (product_config.h).
+void nxpInit(nxpDisplay *d, const nxpConfig *cfg, int peripheralBusClock);
+int nxpReady(nxpDisplay *d);
+
+// The i2c bus speed (SCL Hz) nxpInit() settled on: the fastest that
+// works, up to 400KHz. Stepped down automatically if NACKs start to
+// turn up.
+uint32_t nxpBusSpeed(nxpDisplay *d);
+
+
+// Write a string to one of the LCDs. The write is queued, and this
+// returns without waiting for the i2c bus. Writes to an LCD that isn't
+// fitted (nxpConfig.lcds) are refused.
+int lcdWrite(nxpDisplay *d,
+             int lcd,  // LCD to write to (LCD_L1, LCD_L2, LCD_S1,... )
              char *s); // The string to write; usually digits, with optional periods or commas
-             
+
+// As lcdWrite, with completion reported via callback (from the i2c
+// interrupt) and/or a handle for i2cPoll()/i2cWait(). Any of done, ctx
+// and handle may be 0.
+int lcdWriteAsync(nxpDisplay *d, int lcd, const char *s,
+                  i2cCallback done, void *ctx, i2cHandle *handle);
+
+// As lcdWrite, but blocks until the write is on the glass (or failed).
+int lcdWriteSync(nxpDisplay *d, int lcd, char *s);
+
+// Gather writes to several LCDs into one frame. Between these two calls,
+// lcdWrite()s are only staged; lcdCommitFrame() then sends the frame as
+// one i2c transaction per controller address, so everything on a glass
+// changes together. *handle (may be 0) is set to the frame's last
+// transaction.
+void lcdBeginFrame(nxpDisplay *d);
+int lcdCommitFrame(nxpDisplay *d, i2cHandle *handle);
+
+// Blink an LCD using the controllers' blink engine: one command, rather
+// than a stream of writes. The rate is shared by the LCDs on one
+// controller address (L1 & L2; S1..S3), so the last rate set applies to
+// all the blinking LCDs there. Returns 0 once queued.
+#define LCD_BLINK_OFF    0
+#define LCD_BLINK_2HZ    1
+#define LCD_BLINK_1HZ    2
+#define LCD_BLINK_0_5HZ  3
+int lcdBlink(nxpDisplay *d, int lcd, int rate);
+
+// Counter (odometer) mode: show a scaled integer, like lcdWrite() of
+// fmtFixed(value, <digits>, decimals) (dispense.h), then step it. Each
+// step carries through the digits like an odometer and re-renders only
+// the digits that rolled over, so a step costs about one digit's work
+// instead of formatting and encoding the whole string. Any other write
+// to the LCD ends counter mode. Works inside frames, as lcdWrite() does.
+// Each returns 0 once queued (or staged).
+int lcdCounterStart(nxpDisplay *d, int lcd, uint32_t value, int decimals);
+int lcdCounterAdd(nxpDisplay *d, int lcd, uint32_t delta);
+
+// Move a counter to 'value': a step up (lcdCounterAdd()) if it's more
+// than the one shown, else a fresh lcdCounterStart() (same decimals).
+int lcdCounterSet(nxpDisplay *d, int lcd, uint32_t value);
+
+// Marquee: scroll 'text' across an LCD, right to left, a glyph every
+// stepMs, and round again when it has gone off the left. The text is
+// encoded once, up front (periods and commas included, on the digits
+// that have them wired); each step just moves a window along it, from a
+// scheduler timer, so it runs in the background. Any other write to the
+// LCD ends it, as does text 0 or stepMs 0 (the glass keeps what's
+// showing). Up to LCD_SCROLL_MAX glyphs. Returns 0 once the first step is
+// queued; 1 if the text is too long or there's no timer to spare.
+int lcdScroll(nxpDisplay *d, int lcd, const char *text, uint32_t stepMs);
+
+// Coalescing: rather than queue every write, keep just the latest image
+// per LCD, and send whatever's waiting at most hz times a second (as one
+// frame). A newer write replaces one that hasn't gone yet, so a caller
+// can write as often as it likes and the bus only carries what could be
+// seen. A write that's on its own after a quiet spell goes at once.
+// Writes and frames that ask for completion (a callback or a handle,
+// e.g. lcdWriteSync()) still go straight away, replacing what's waiting
+// for their LCDs. hz of 0 writes everything through, as before; default
+// LCD_REFRESH_HZ (product_config.h). Returns 1 if hz is out of range.
+int lcdRefreshRate(nxpDisplay *d, int hz);
+
+// Send any waiting (coalesced) updates now. *handle (may be 0) is set as
+// for lcdCommitFrame(). Returns 0 once queued.
+int lcdFlush(nxpDisplay *d, i2cHandle *handle);
+
+// Lamp test: play anim (animLampTest, anim_table.h) over the fitted
+// LCDs, then put each back to the latest content written to it; writes
+// in the meantime are held until then (a write or frame asking for
+// completion still goes straight away), and counters and marquees keep
+// counting underneath. Runs in the background. Returns 0 once started.
+int lcdLampTest(nxpDisplay *d, const lcdAnim *anim);
+
+// Play a canned animation: each frame's raw segment data straight to the
+// controllers (one transaction per controller address, nothing to
+// format or encode), then the next after the frame's ms, from a
+// scheduler timer. Frames aren't coalesced, so the timing holds whatever
+// else is going on; the LCDs a frame writes leave counter or marquee
+// mode. When the last frame's time is up, done(ctx) is called (done may
+// be 0); the glass keeps the last frame. Starting another animation, or
+// anim 0, stops the one playing (without its done). Returns 0 once the
+// first frame is queued; Error code otherwise (1 if a frame is open, or
+// a lamp test is on).
+int lcdPlay(nxpDisplay *d, const lcdAnim *anim, schedFunc done, void *ctx);
+
+// Double buffering: frames (and lcdWrite()s) are written into the
+// controllers' hidden RAM bank, then put on the glass with one bank
+// select command, so no half-written value is ever shown. Costs one
+// extra (1-2 byte) transaction per update, plus catching up the hidden
+// bank. On by default with LCD_DOUBLE_BUFFER (product_config.h).
+void lcdDoubleBuffer(nxpDisplay *d, int on);
+
 
 // ---------------------------------------------------------------------
 // Private functions - not intended for external use
@@ -34,12 +260,14 @@ int h4198_SetSegments(const char *displayStr,   // Display string to process
 int h4235_SetSegments(const char *displayStr,   // String to display
                       uint8_t segmentData[8]);  // 60 bits (7.5 bytes) segment data
 
-// Send a raw segmentData[] array to the LCD controller IC
-int h4198_Write(int dispNumber, uint8_t segmentData[5]);
-int h4235_Write(int dispNumber, uint8_t segmentData[8]);
+// Queue a raw segmentData[] array for the LCD controller IC
+int h4198_Write(nxpDisplay *d, int dispNumber, uint8_t segmentData[5],
+                i2cCallback done, void *ctx, i2cHandle *handle);
+int h4235_Write(nxpDisplay *d, int dispNumber, uint8_t segmentData[8],
+                i2cCallback done, void *ctx, i2cHandle *handle);
 
 
-int nxpRawWrite(uint8_t i2c_address, uint8_t data[], int n);
+int nxpRawWrite(nxpDisplay *d, uint8_t i2c_address, uint8_t data[], int n);
 uint8_t sevenSegCode(char c);
 
 #endif
@@ -0,0 +1,74 @@
+//
+// perf_stats
+//
+// LXD Research & Display
+//
+// Core timer based hot-path statistics; see perf_stats.h. perfRecord()
+// is called from main-line code and from the I2C interrupt, but each
+// perfTimer is only ever updated from one of the two (see the fields in
+// perfStats), so there's no locking.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "perf_stats.h"
+
+#ifdef LCD_PERF_STATS
+
+#if defined __PIC32MX__
+  #include <p32xxxx.h>
+#else
+  #include <time.h>
+#endif
+
+
+volatile perfStats lcdPerf;
+
+
+// perfNow
+//
+// Core timer count. The host build stands in the monotonic clock, scaled
+// to the same rate.
+//
+uint32_t perfNow(void)
+{
+#if defined __PIC32MX__
+    return _CP0_GET_COUNT();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec)
+                      / (1000000000ULL / PERF_TICK_HZ));
+#endif
+}
+
+
+// perfRecord - Add one sample (core timer ticks) to a timer
+//
+void perfRecord(volatile perfTimer *t, uint32_t ticks)
+{
+    int b = 0;
+    uint32_t v = ticks >> PERF_HIST_SHIFT;
+
+    if(t->count == 0 || ticks < t->min) t->min = ticks;
+    if(ticks > t->max) t->max = ticks;
+    t->total += ticks;
+    t->count++;
+
+    // Bucket = bit length of ticks >> SHIFT, clamped
+    if(v)
+        b = 32 - __builtin_clz(v);
+    if(b >= PERF_HIST_BUCKETS)
+        b = PERF_HIST_BUCKETS - 1;
+    t->hist[b]++;
+}
+
+
+void perfReset(void)
+{
+    memset((void *)&lcdPerf, 0, sizeof(lcdPerf));
+}
+
+#endif
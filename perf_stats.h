@@ -0,0 +1,82 @@
+#ifndef _PERF_STATS_H_
+#define _PERF_STATS_H_
+
+// perf_stats
+//
+// Hot-path timing for the LCD driver and I2C engine, from the CP0 core
+// timer (which counts at half the CPU clock). Everything lands in one
+// fixed RAM structure, lcdPerf, which can be read at runtime (debugger
+// watch, or dumped by the application).
+//
+// Enabled by defining LCD_PERF_STATS (product_config.h). Otherwise the
+// PERF_xxx macros expand to nothing, and lcdPerf doesn't exist.
+
+#include <stdint.h>
+
+#include "product_config.h"
+
+#define PERF_TICK_HZ      (CPU_HZ / 2)   // Core timer rate
+
+// Histogram buckets are powers of two: bucket 0 counts anything under
+// 2^PERF_HIST_SHIFT ticks, bucket k [2^(k+SHIFT-1), 2^(k+SHIFT)), and the
+// last bucket everything longer.
+#define PERF_HIST_BUCKETS 16
+#define PERF_HIST_SHIFT   6              // 64 ticks = 1.6us at 80MHz
+
+
+#ifdef LCD_PERF_STATS
+
+typedef struct
+{
+    uint32_t count;       // Samples
+    uint32_t min;         // Core timer ticks
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PERF_HIST_BUCKETS];
+} perfTimer;
+
+typedef struct
+{
+    // Per call, main line
+    perfTimer lcdWrite;      // lcdWriteAsync(), encode to queued
+    perfTimer encode;        // h4235_SetSegments() / h4198_SetSegments()
+    perfTimer rawWrite;      // nxpRawWrite(), submit to complete
+
+    // Per transaction, from the I2C engine
+    perfTimer queueWait;     // i2cSubmit() until it starts on the bus
+    perfTimer busTime;       // Start until its stop completes
+    perfTimer stall;         // Waiting on a busy bus before the start
+
+    uint32_t transactions;   // Completed (ok or not)
+    uint32_t bytes;          // Bytes ACK'd, incl. slave addresses
+    uint32_t nacks;          // Address or data bytes not ACK'd
+    uint32_t errors;         // Transactions that failed
+    uint32_t idleStalls;     // Bus found busy at the start of a transaction
+    uint32_t stopRecoveries; // Busy bus freed by our I2CStop
+    uint32_t timeouts;       // Bus steps that overran I2C_STEP_TIMEOUT_US
+    uint32_t busRecoveries;  // busRecover() sequences run
+} perfStats;
+
+extern volatile perfStats lcdPerf;
+
+uint32_t perfNow(void);                                 // Core timer count
+void     perfRecord(volatile perfTimer *t, uint32_t ticks);
+void     perfReset(void);
+
+#define PERF_VAR(v)           uint32_t v;
+#define PERF_MARK(v)          ((v) = perfNow())
+#define PERF_END(timer, v)    perfRecord(&lcdPerf.timer, perfNow() - (v))
+#define PERF_ADD(timer, ticks) perfRecord(&lcdPerf.timer, (ticks))
+#define PERF_COUNT(ctr, n)    (lcdPerf.ctr += (n))
+
+#else
+
+#define PERF_VAR(v)
+#define PERF_MARK(v)          ((void)0)
+#define PERF_END(timer, v)    ((void)0)
+#define PERF_ADD(timer, ticks) ((void)0)
+#define PERF_COUNT(ctr, n)    ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+//
+// pos_link
+//
+// LXD Research & Display
+//
+// Site controller command link; see pos_link.h. Bytes come out of the
+// UART ring into rx[], which only ever holds the frame being parsed:
+// anything ahead of a SOF is skipped, and a frame that fails its length
+// or CRC check loses just its SOF byte, so a real frame that started
+// inside it is still found.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "product_config.h"
+#include "pos_link.h"
+#include "uart.h"
+#include "sched.h"
+
+#ifdef POS_LINK
+
+
+static nxpDisplay *disp;               // POS_TEXT goes here
+static uint8_t  rx[POS_FRAME_MAX];     // Frame being parsed, from its SOF
+static int      rxN;
+static uint8_t  lastSeq, lastCmd;      // The frame before, for spotting resends
+static uint8_t  lastStatus = POS_ERR_BUSY;   // (a resend of a BUSY is applied)
+static uint32_t frames, dropped;
+
+static void posTask(void *ctx);
+
+
+void posInit(nxpDisplay *d, int pbClk, uint32_t baud)
+{
+    disp = d;
+    rxN = 0;
+    uartInit(pbClk, baud);
+    schedTimerStart(posTask, 0, POS_POLL_MS, POS_POLL_MS);
+}
+
+
+uint32_t posFrames(void)
+{
+    return frames;
+}
+
+
+uint32_t posDropped(void)
+{
+    return dropped;
+}
+
+
+// posCrc - CRC-16/CCITT, a byte at a time without a table
+//
+static uint16_t posCrc(const uint8_t *p, int n)
+{
+    uint16_t crc = 0xffff;
+    uint8_t x;
+
+    while(n--)
+    {
+        x = (crc >> 8) ^ *p++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+    }
+    return crc;
+}
+
+
+// posEncode - Build a frame (see pos_link.h)
+//
+int posEncode(uint8_t *out, uint8_t seq, uint8_t cmd, const uint8_t *payload, int n)
+{
+    uint16_t crc;
+
+    if(n < 0 || n > POS_MAX_LEN - 2) return 0;
+
+    out[0] = POS_SOF;
+    out[1] = n + 2;
+    out[2] = seq;
+    out[3] = cmd;
+    memcpy(&out[4], payload, n);
+    crc = posCrc(&out[1], n + 3);
+    out[n + 4] = crc >> 8;
+    out[n + 5] = crc & 0xff;
+    return n + 6;
+}
+
+
+// posPrice - { grade, price } pairs, in order
+//
+static int posPrice(const uint8_t *p, int n)
+{
+    int status = POS_OK;
+
+    if(n == 0 || n % 5) return POS_ERR_ARG;
+
+    for(; n && status == POS_OK; p += 5, n -= 5)
+        status = posSetPrice(p[0], p[1] | (p[2] << 8) | (p[3] << 16) | ((uint32_t)p[4] << 24));
+    return status;
+}
+
+
+// posText - { lcd, len, text } entries, staged then committed as one
+//           frame. The entries are all checked before any is written;
+//           an LCD the set hasn't got is refused, but the rest still go.
+//
+static int posText(const uint8_t *p, int n)
+{
+    char s[POS_TEXT_MAX + 1];
+    int i, len, status = POS_OK;
+
+    for(i = 0; i < n; i += 2 + len)
+    {
+        if(n - i < 2) return POS_ERR_ARG;
+        len = p[i + 1];
+        if(p[i] < LCD_L1 || p[i] > LCD_S3 || len > POS_TEXT_MAX || len > n - i - 2)
+            return POS_ERR_ARG;
+    }
+    if(n == 0) return POS_ERR_ARG;
+
+    lcdBeginFrame(disp);
+    for(i = 0; i < n; i += 2 + len)
+    {
+        len = p[i + 1];
+        memcpy(s, &p[i + 2], len);
+        s[len] = 0;
+        if(lcdWrite(disp, p[i], s))
+            status = POS_ERR_ARG;
+    }
+    if(lcdCommitFrame(disp, 0))
+        return POS_ERR_BUSY;
+    return status;
+}
+
+
+// posFrame - Apply a good frame (unless it's a resend), and reply
+//
+static void posFrame(uint8_t seq, uint8_t cmd, const uint8_t *p, int n)
+{
+    uint8_t reply[POS_FRAME_MAX];
+    uint8_t r[2];
+    int status;
+
+    if(seq == lastSeq && cmd == lastCmd && lastStatus != POS_ERR_BUSY)
+        status = lastStatus;                    // Resend: answer it again
+    else
+    {
+        switch(cmd)
+        {
+            case POS_PING:  status = n ? POS_ERR_ARG : POS_OK;          break;
+            case POS_PRICE: status = posPrice(p, n);                    break;
+            case POS_GRADE: status = n == 1 ? posSelectGrade(p[0]) : POS_ERR_ARG;  break;
+            case POS_TEXT:  status = posText(p, n);                     break;
+            default:        status = POS_ERR_CMD;                       break;
+        }
+    }
+    lastSeq = seq;
+    lastCmd = cmd;
+    lastStatus = status;
+
+    // With no room to send it, the reply is lost; the controller resends
+    r[0] = cmd;
+    r[1] = status;
+    uartWrite(reply, posEncode(reply, seq, POS_REPLY, r, 2));
+}
+
+
+// posSkip - Drop n bytes from the front of rx[]
+//
+static void posSkip(int n)
+{
+    rxN -= n;
+    memmove(rx, &rx[n], rxN);
+}
+
+
+// posTask
+//
+// Runs every POS_POLL_MS: whatever fits in rx[] is taken from the ring
+// and parsed, so at most a frame's worth of bytes (a few small frames, or
+// one big one) is handled per run.
+//
+static void posTask(void *ctx)
+{
+    int n, len;
+
+    (void)ctx;
+    rxN += uartRead(&rx[rxN], sizeof(rx) - rxN);
+
+    while(rxN)
+    {
+        for(n = 0; n < rxN && rx[n] != POS_SOF; n++)
+            ;
+        if(n)                                   // Noise ahead of the SOF
+        {
+            dropped += n;
+            posSkip(n);
+            continue;
+        }
+        if(rxN < 2)
+            break;
+        len = rx[1];
+        if(len < 2 || len > POS_MAX_LEN ||
+           (rxN >= len + 4 && posCrc(&rx[1], len + 1) != ((rx[len + 2] << 8) | rx[len + 3])))
+        {
+            dropped++;                          // Not a frame: try from the next SOF
+            posSkip(1);
+            continue;
+        }
+        if(rxN < len + 4)
+            break;                              // The rest is still to come
+
+        frames++;
+        posFrame(rx[2], rx[3], &rx[4], len - 2);
+        posSkip(len + 4);
+    }
+}
+
+#endif
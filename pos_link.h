@@ -0,0 +1,72 @@
+#ifndef _POS_LINK_H_
+#define _POS_LINK_H_
+
+// pos_link
+//
+// Command link from the site controller (POS / console) over the UART
+// (uart.h): price changes, grade selection and display text, at
+// runtime. It runs as a scheduler task, taking a bounded slice of what
+// has arrived each tick, so a burst from the POS just waits in the
+// receive ring rather than holding up the dispensing or the displays.
+//
+// Frames (both ways):
+//
+//   SOF   LEN   SEQ   CMD   payload       CRC
+//   0x7e  n     seq   cmd   n - 2 bytes   2 bytes, high first
+//
+// LEN counts SEQ, CMD and the payload (2..POS_MAX_LEN). The CRC is
+// CRC-16/CCITT (polynomial 0x1021, from 0xffff) over LEN up to the end
+// of the payload. Multi-byte values are little endian.
+//
+// Each good frame is answered with a POS_REPLY frame with its SEQ, and
+// the command and its status as the payload. Frames that fail the CRC or
+// the length check get no reply; they're skipped a byte at a time until
+// the next good frame, so the controller only has to time out and
+// resend. A resend (the same SEQ and CMD as the frame before) is
+// answered again, but not applied twice.
+
+#include <stdint.h>
+
+#include "nxp_lcd_driver.h"
+
+#define POS_SOF        0x7e
+#define POS_MAX_LEN    64      // Most LEN
+#define POS_FRAME_MAX  (POS_MAX_LEN + 4)
+#define POS_POLL_MS    1       // How often the link runs
+#define POS_TEXT_MAX   16      // Longest string for one LCD
+
+// Commands (CMD) and their payloads
+#define POS_PING       0x00    // None; just the reply
+#define POS_PRICE      0x01    // { grade, price (4 bytes, tenths of a cent per gallon) }, 1 or more
+#define POS_GRADE      0x02    // { grade }: change over to it
+#define POS_TEXT       0x03    // { lcd (LCD_L1..LCD_S3), len, text[len] }, 1 or more: all
+                               // shown together, as one frame
+#define POS_REPLY      0x80    // { cmd, status }
+
+// Status
+#define POS_OK         0
+#define POS_ERR_CMD    1       // Unknown command
+#define POS_ERR_ARG    2       // Bad payload: length, grade, lcd or text
+#define POS_ERR_BUSY   3       // Couldn't be applied just now (display queue full); resend
+
+
+// Start the link on the UART at baud, showing POS_TEXT on display set d.
+void posInit(nxpDisplay *d, int peripheralBusClock, uint32_t baud);
+
+// Build a frame into out (POS_FRAME_MAX bytes will do). Returns its
+// length, or 0 if the payload is too long.
+int posEncode(uint8_t *out, uint8_t seq, uint8_t cmd, const uint8_t *payload, int n);
+
+// Running counts: good frames, and bytes skipped (noise, and the SOFs
+// of frames that failed their checks).
+uint32_t posFrames(void);
+uint32_t posDropped(void);
+
+
+// Implemented by the application (demo.c). Each returns POS_OK, or
+// POS_ERR_ARG to refuse (an unknown grade, say). A POS_PRICE frame's
+// prices are applied in order, stopping at the first refused.
+int posSetPrice(int grade, uint32_t price);
+int posSelectGrade(int grade);
+
+#endif
@@ -24,6 +24,50 @@
 #define GILBARCO_DUINOMITE
 
 
+// Uncomment to collect LCD driver & I2C timing stats (lcdPerf, in
+// perf_stats.h). Costs a core timer read or two per call/transaction.
+//#define LCD_PERF_STATS
+
+// Comment out to write the LCDs in place, rather than double buffered
+// through the controllers' spare RAM bank (see lcdDoubleBuffer()).
+#define LCD_DOUBLE_BUFFER
+
+// Most times a second each display set's LCDs are updated; writes in
+// between are coalesced, latest wins (see lcdRefreshRate()). Comment out
+// to send every write as it's made.
+#define LCD_REFRESH_HZ  25
+
+// Uncomment for a lamp test (animLampTest: all segments on, all off,
+// then each segment bit in turn) once the LCDs are up. It runs in the
+// background; anything written meanwhile shows when it ends (see
+// lcdLampTest()).
+//#define LCD_LAMP_TEST
+
+// Uncomment to take the fill-up demo's volume from a flow meter pulser
+// on IC1 (flow.c), rather than faking it. FLOW_K_FACTOR is the meter's
+// pulses per gallon, in thousandths.
+//#define FLOW_PULSER
+#define FLOW_K_FACTOR  100000
+
+// Uncomment to take prices, grade selection and display text from the
+// site controller, over UART2 at POS_BAUD (pos_link.h).
+//#define POS_LINK
+#define POS_BAUD  115200
+
+// Comment out to drop the CPU load accounting (cpuLoad, in cpu_load.h).
+// Costs a core timer read per interrupt, and per LCD driver call.
+#define CPU_LOAD_STATS
+
+// Uncomment to trace every I2C transaction into RAM (i2c_trace.h),
+// I2C_TRACE records per bus, for host/trace_dec. Without the POS link,
+// the trace is sent out of UART2 at I2C_TRACE_BAUD as it's taken.
+// Costs a copy of each transaction's bytes, and a ring for each of
+// buses 0 .. I2C_TRACE_BUSES - 1 (one per display set).
+//#define I2C_TRACE  32
+#define I2C_TRACE_BUSES  1
+#define I2C_TRACE_BAUD  460800
+
+
 
 // Define C++/C99 style bool type, with values true and false.
 // Note: Stay away from uppercase TRUE & FALSE; uChip defines
@@ -0,0 +1,36 @@
+#ifndef _PULSER_H_
+#define _PULSER_H_
+
+// pulser
+//
+// The narrow interface that the flow meter (flow.c) runs on: a pulser
+// input that timestamps every edge. There are two backends, picked at
+// link time:
+//
+//   pulser_p32.c          PIC32 input capture (IC1), timed by Timer2/3
+//   host/pulser_host.c    Linux host build; a simulated pulser running
+//                         on the virtual clock
+//
+// The backend reports each edge by calling flowEdge() with its capture
+// time - from the input capture interrupt on the PIC32, from the virtual
+// clock on the host.
+
+#include <stdint.h>
+
+
+// Start capturing edges. Returns the capture timer's rate, in ticks per
+// second.
+uint32_t pulserInit(int peripheralBusClock);
+
+// Capture timer now (free running, 32 bits; wraps), in the same ticks
+// as the edge times.
+uint32_t pulserNow(void);
+
+// Running count of edges the hardware dropped (capture FIFO overrun).
+uint32_t pulserOverruns(void);
+
+
+// Implemented by the flow meter (flow.c)
+void flowEdge(uint32_t stamp);
+
+#endif
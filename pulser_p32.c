@@ -0,0 +1,71 @@
+//
+// pulser_p32
+//
+// LXD Research & Display
+//
+// PIC32 backend for pulser.h: the pulser on input capture 1 (IC1, RD8),
+// each rising edge captured against Timer2/3 run as one free running
+// 32 bit timer.
+//
+// The capture interrupt is at priority 5, above the I2C (3) and tick (2)
+// interrupts, so an edge is counted within microseconds however busy
+// the LCD buses are. The capture FIFO holds 4 edges besides, so edges
+// are only lost if the interrupt is held off for 4 pulser periods.
+//
+
+#include <p32xxxx.h>
+#include <plib.h>
+
+#include "product_config.h"
+#include "pulser.h"
+#include "cpu_load.h"
+
+
+#define PULSER_PRESCALE  8     // Timer2/3 at pbClk / 8 (5MHz at 40MHz: wraps in 859s)
+
+static volatile uint32_t overruns;
+
+
+// pulserInit
+//
+// Timer2/3 free running, then IC1 capturing its count on every rising
+// edge, interrupting on each capture.
+//
+uint32_t pulserInit(int pbClk)
+{
+    PORTSetPinsDigitalIn(IOPORT_D, BIT_8);
+    OpenTimer23(T23_ON | T23_SOURCE_INT | T23_PS_1_8, 0xffffffff);
+    OpenCapture1(IC_ON | IC_CAP_32BIT | IC_TIMER2_SRC | IC_INT_1CAPTURE | IC_EVERY_RISE_EDGE);
+    mIC1ClearIntFlag();
+    ConfigIntCapture1(IC_INT_ON | IC_INT_PRIOR_5 | IC_INT_SUB_PRIOR_0);
+    return pbClk / PULSER_PRESCALE;
+}
+
+
+uint32_t pulserNow(void)
+{
+    return ReadTimer23();
+}
+
+
+uint32_t pulserOverruns(void)
+{
+    return overruns;
+}
+
+
+// Input capture 1 interrupt: hand every captured edge to the flow meter.
+// Reading the FIFO empty clears an overrun, so it's noted first.
+//
+void __ISR(_INPUT_CAPTURE_1_VECTOR, ipl5) pulserInterrupt(void)
+{
+    CPU_IRQ_VAR(t0)
+
+    CPU_IRQ_ENTER(t0);
+    if(IC1CONbits.ICOV)
+        overruns++;
+    while(mIC1CaptureReady())
+        flowEdge(mIC1ReadCapture());
+    mIC1ClearIntFlag();
+    CPU_IRQ_LEAVE(CPU_IRQ, t0);
+}
@@ -0,0 +1,149 @@
+//
+// sched
+//
+// LXD Research & Display
+//
+// Cooperative tick scheduler; see sched.h. The tick interrupt touches
+// nothing but tickCount, and the timer table is only used from
+// main-line code, so there's no locking.
+//
+// A timer id is its slot plus SCHED_MAX_TIMERS times the slot's
+// generation, which counts up each time the slot is armed; so an id
+// kept after its one-shot fired no longer matches once the slot has
+// been reused, and schedTimerStop() leaves the new timer alone.
+//
+
+#include <stdint.h>
+
+#include "sched.h"
+#include "cpu_load.h"
+
+#if defined __PIC32MX__
+  #include <p32xxxx.h>
+  #include <plib.h>
+#endif
+
+
+typedef struct
+{
+    schedFunc fn;        // 0 if the slot is free
+    void     *ctx;
+    uint32_t  due;       // Tick to run at
+    uint32_t  period;    // Ticks between runs; 0 = one-shot
+    uint16_t  gen;       // Times the slot has been armed (wraps)
+} schedTimer;
+
+static schedTimer timers[SCHED_MAX_TIMERS];
+static volatile uint32_t tickCount;
+
+
+// schedInit
+//
+// Timer1 from the peripheral bus clock, 1:8 prescale, interrupting at
+// SCHED_TICK_HZ. On the host the tick comes from the virtual clock
+// instead (host/p32_utils.c).
+//
+void schedInit(int pbClk)
+{
+#if defined __PIC32MX__
+    OpenTimer1(T1_ON | T1_SOURCE_INT | T1_PS_1_8, pbClk / 8 / SCHED_TICK_HZ - 1);
+    ConfigIntTimer1(T1_INT_ON | T1_INT_PRIOR_2);
+#else
+    (void)pbClk;
+#endif
+}
+
+
+int schedTimerStart(schedFunc fn, void *ctx, uint32_t delayMs, uint32_t periodMs)
+{
+    int i;
+
+    for(i = 0; i < SCHED_MAX_TIMERS; i++)
+    {
+        if(timers[i].fn == 0)
+        {
+            timers[i].ctx = ctx;
+            timers[i].due = tickCount + delayMs * (SCHED_TICK_HZ / 1000);
+            timers[i].period = periodMs * (SCHED_TICK_HZ / 1000);
+            timers[i].fn = fn;
+            timers[i].gen++;
+            return timers[i].gen * SCHED_MAX_TIMERS + i;
+        }
+    }
+    return SCHED_NO_TIMER;
+}
+
+
+void schedTimerStop(int id)
+{
+    schedTimer *t;
+
+    if(id < 0)
+        return;
+    t = &timers[id % SCHED_MAX_TIMERS];
+    if(t->gen == (uint16_t)(id / SCHED_MAX_TIMERS))
+        t->fn = 0;
+}
+
+
+// schedRunOnce
+//
+// A periodic timer that has fallen behind (a slow task elsewhere) runs
+// once and is rescheduled from now, rather than firing repeatedly to
+// catch up.
+//
+int schedRunOnce(void)
+{
+    schedTimer *t;
+    schedFunc fn;
+    uint32_t now = tickCount;
+    int i, ran = 0;
+
+    for(i = 0; i < SCHED_MAX_TIMERS; i++)
+    {
+        t = &timers[i];
+        if(t->fn == 0 || (int32_t)(now - t->due) < 0)
+            continue;
+
+        fn = t->fn;
+        if(t->period)
+        {
+            t->due += t->period;
+            if((int32_t)(now - t->due) >= 0)
+                t->due = now + t->period;
+        }
+        else
+            t->fn = 0;      // Free before the call, so it can re-arm
+
+        fn(t->ctx);
+        ran++;
+    }
+    return ran;
+}
+
+
+uint32_t schedTicks(void)
+{
+    return tickCount;
+}
+
+
+void schedTick(void)
+{
+    tickCount++;
+}
+
+
+#if defined __PIC32MX__
+// Timer1 interrupt: the tick
+//
+void __ISR(_TIMER_1_VECTOR, ipl2) schedInterrupt(void)
+{
+    CPU_IRQ_VAR(t0)
+
+    CPU_IRQ_ENTER(t0);
+    mT1ClearIntFlag();
+    schedTick();
+    CPU_IRQ_LEAVE(CPU_IRQ, t0);
+}
+#endif
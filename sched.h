@@ -0,0 +1,47 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+// sched
+//
+// Cooperative, run-to-completion task scheduler. A periodic timer
+// interrupt (Timer1, SCHED_TICK_HZ) only counts ticks; the main loop
+// calls schedRunOnce(), which runs every software timer that has come
+// due. A "task" is just a function run from a timer: it does a little
+// work and returns, re-arming a one-shot timer for its next step, or
+// leaving a periodic one to call it again. Nothing may block.
+//
+// Timers live in a small fixed table; a one-shot timer's slot is free
+// again by the time its function runs, so a task can re-arm itself.
+
+#include <stdint.h>
+
+#define SCHED_TICK_HZ     1000   // 1ms ticks
+#define SCHED_MAX_TIMERS  12     // Timers that can be armed at once
+#define SCHED_NO_TIMER    (-1)
+
+typedef void (*schedFunc)(void *ctx);
+
+// Start the tick interrupt.
+void schedInit(int peripheralBusClock);
+
+// Arm a timer: fn(ctx) runs after delayMs, then every periodMs (or just
+// the once, if periodMs is 0). A delay of 0 runs it on the next pass.
+// Returns the timer id, or SCHED_NO_TIMER if the table is full.
+int schedTimerStart(schedFunc fn, void *ctx, uint32_t delayMs, uint32_t periodMs);
+
+// Disarm a timer. Harmless if it has already fired (even once its slot
+// has gone to another timer; ids aren't reused until the slot has been
+// armed 65536 times more), or id is SCHED_NO_TIMER.
+void schedTimerStop(int id);
+
+// Run whatever is due; returns the number of timers that fired. Call
+// from the main loop, as often as possible.
+int schedRunOnce(void);
+
+// Tick count (ms); wraps.
+uint32_t schedTicks(void);
+
+// Advance the tick. Called from the tick interrupt (or the host clock).
+void schedTick(void);
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef _SPSC_H_
+#define _SPSC_H_
+
+// spsc
+//
+// Lock-free hand-offs between one producer and one consumer - typically
+// an interrupt and main-line code - with no interrupts masked and no
+// waiting on the interrupt side. Both are macros that define a type,
+// sized at compile time, and its (inlined, constant time) functions:
+//
+//   SPSC_RING(name, type, size)   A FIFO of size (a power of 2) items:
+//
+//       name                      the ring; give it static (zeroed) storage
+//       int  namePut(name *r, const type *v)   Producer; 1 if full
+//       int  nameGet(name *r, type *v)         Consumer; 1 if empty
+//       int  nameCount(name *r)                Items waiting (either side)
+//
+//     and, to fill or read an item in place (for big items, or to keep
+//     an item until it's been passed on):
+//
+//       type *nameReserve(name *r)  Producer; the free slot, or 0 if full
+//       void  nameCommit(name *r)   Producer; put the reserved slot
+//       type *namePeek(name *r)     Consumer; the oldest item, or 0
+//       void  namePop(name *r)      Consumer; free the peeked item
+//
+//   SPSC_SNAPSHOT(name, type)     A seqlock: the latest value of type,
+//                                 written whole and read whole:
+//
+//       name                      the snapshot; static (zeroed) storage
+//       void nameWrite(name *s, const type *v) Writer; never waits
+//       void nameRead(name *s, type *v)        Reader; goes round again
+//                                              if a write got in
+//
+//   (name is pasted on: a ring called fooRing has fooRingPut(), etc.)
+//
+// The memory model these rely on: the PIC32's M4K is one in-order core,
+// so loads and stores happen in program order, and an interrupt sees
+// everything main-line code stored before it (and vice versa). Only the
+// compiler can reorder them, and SPSC_BARRIER() stops that; on the host
+// build it's a full fence, for the benefit of threaded tests. Aligned
+// 32 bit loads and stores are single instructions, so head, tail and seq
+// can't be torn.
+//
+// The ring's head is only stored by the producer and its tail only by
+// the consumer; both run freely and wrap, and their difference is the
+// count. A snapshot's reader must be the one that can be interrupted (a
+// snapshot read from an interrupt, of a value main-line code writes,
+// would spin for ever on a write that can't finish), so that's
+// interrupt to main line only; a ring works either way.
+
+#include <stdint.h>
+
+#if defined __PIC32MX__
+  #define SPSC_BARRIER()   __asm__ volatile("" ::: "memory")
+#else
+  #define SPSC_BARRIER()   __sync_synchronize()
+#endif
+
+
+#define SPSC_RING(name, type, size)                                         \
+    typedef struct                                                          \
+    {                                                                       \
+        volatile uint32_t head;     /* Items put; producer only */          \
+        volatile uint32_t tail;     /* Items got; consumer only */          \
+        type slot[size];                                                    \
+    } name;                                                                 \
+                                                                            \
+    typedef char name##SizeCheck[((size) & ((size) - 1)) ? -1 : 1];         \
+                                                                            \
+    static inline int name##Put(name *r, const type *v)                     \
+    {                                                                       \
+        uint32_t h = r->head;                                               \
+                                                                            \
+        if(h - r->tail >= (size)) return 1;                                 \
+        r->slot[h & ((size) - 1)] = *v;                                     \
+        SPSC_BARRIER();             /* The item, then the head */           \
+        r->head = h + 1;                                                    \
+        return 0;                                                           \
+    }                                                                       \
+                                                                            \
+    static inline int name##Get(name *r, type *v)                           \
+    {                                                                       \
+        uint32_t t = r->tail;                                               \
+                                                                            \
+        if(r->head == t) return 1;                                          \
+        SPSC_BARRIER();             /* The head, then the item */           \
+        *v = r->slot[t & ((size) - 1)];                                     \
+        SPSC_BARRIER();             /* The item, then freeing its slot */   \
+        r->tail = t + 1;                                                    \
+        return 0;                                                           \
+    }                                                                       \
+                                                                            \
+    static inline int name##Count(name *r)                                  \
+    {                                                                       \
+        return (int)(r->head - r->tail);                                    \
+    }                                                                       \
+                                                                            \
+    static inline type *name##Reserve(name *r)                              \
+    {                                                                       \
+        uint32_t h = r->head;                                               \
+                                                                            \
+        if(h - r->tail >= (size)) return 0;                                 \
+        return &r->slot[h & ((size) - 1)];                                  \
+    }                                                                       \
+                                                                            \
+    static inline void name##Commit(name *r)                                \
+    {                                                                       \
+        SPSC_BARRIER();                                                     \
+        r->head = r->head + 1;                                              \
+    }                                                                       \
+                                                                            \
+    static inline type *name##Peek(name *r)                                 \
+    {                                                                       \
+        uint32_t t = r->tail;                                               \
+                                                                            \
+        if(r->head == t) return 0;                                          \
+        SPSC_BARRIER();                                                     \
+        return &r->slot[t & ((size) - 1)];                                  \
+    }                                                                       \
+                                                                            \
+    static inline void name##Pop(name *r)                                   \
+    {                                                                       \
+        SPSC_BARRIER();                                                     \
+        r->tail = r->tail + 1;                                              \
+    }
+
+
+#define SPSC_SNAPSHOT(name, type)                                           \
+    typedef struct                                                          \
+    {                                                                       \
+        volatile uint32_t seq;      /* Odd while a write is under way */    \
+        type v;                                                             \
+    } name;                                                                 \
+                                                                            \
+    static inline void name##Write(name *s, const type *v)                  \
+    {                                                                       \
+        s->seq = s->seq + 1;                                                \
+        SPSC_BARRIER();                                                     \
+        s->v = *v;                                                          \
+        SPSC_BARRIER();                                                     \
+        s->seq = s->seq + 1;                                                \
+    }                                                                       \
+                                                                            \
+    static inline void name##Read(name *s, type *v)                         \
+    {                                                                       \
+        uint32_t q;                                                         \
+                                                                            \
+        do                                                                  \
+        {                                                                   \
+            q = s->seq;                                                     \
+            SPSC_BARRIER();                                                 \
+            *v = s->v;                                                      \
+            SPSC_BARRIER();                                                 \
+        } while((q & 1) || s->seq != q);                                    \
+    }
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _UART_H_
+#define _UART_H_
+
+// uart
+//
+// The narrow interface that the POS link (pos_link.c) runs on: a byte
+// stream in and out, neither of which waits. There are two backends,
+// picked at link time:
+//
+//   uart_p32.c          PIC32 UART2; received bytes go straight into a
+//                       ring by DMA, so there's no interrupt per byte,
+//                       and the transmit interrupt drains the queue
+//   host/uart_host.c    Linux host build; the test feeds the receive
+//                       ring and reads back what's sent
+//
+// Everything here is main-line code only.
+
+#include <stdint.h>
+
+#define UART_RX_RING  256    // Receive ring (22ms of 115200 baud)
+#define UART_TX_RING  128    // Transmit queue (a power of 2; spsc.h)
+
+
+// Start the UART at baud, 8N1, receiving into the ring.
+void uartInit(int peripheralBusClock, uint32_t baud);
+
+// Take up to max received bytes out of the ring. Returns the number
+// taken (0 if there are none).
+int uartRead(uint8_t *buf, int max);
+
+// Queue bytes to send. Returns the number taken: all of them, or none
+// if the queue hasn't room for all n.
+int uartWrite(const uint8_t *buf, int n);
+
+// Running count of receive errors (receiver overruns).
+uint32_t uartErrors(void);
+
+#endif
@@ -0,0 +1,139 @@
+//
+// uart_p32
+//
+// LXD Research & Display
+//
+// PIC32 backend for uart.h: UART2, 8N1. A DMA channel copies each
+// received byte from U2RXREG into rxRing, started by the UART's receive
+// flag (the interrupt itself stays off); it's auto-enabled, so it wraps
+// round the ring for ever, and the CPU only ever sees the bytes when it
+// asks for them. The channel's destination pointer is the ring's head.
+//
+// Nothing tells us if the DMA laps the reader, so the ring must hold
+// more than arrives between uartRead()s (UART_RX_RING is 22ms at
+// 115200 baud, against the POS link's 1ms poll); the frame CRCs catch
+// anything lost anyway.
+//
+// Sending is interrupt driven: uartWrite() puts the bytes on an SPSC
+// ring (spsc.h) and turns the transmit interrupt on; the interrupt
+// tops up the 8 byte FIFO from it, and turns itself off again once the
+// ring is empty. The receive ring isn't one of those - its producer is
+// the DMA, which only knows its own pointer - so it keeps a plain tail.
+//
+// The transmit interrupt is at priority 1, below everything else: a
+// FIFO's worth of bytes lasts 690us at 115200 baud.
+//
+
+#include <p32xxxx.h>
+#include <plib.h>
+
+#include "product_config.h"
+#include "uart.h"
+#include "spsc.h"
+#include "cpu_load.h"
+
+
+#define UART_DMA  DMA_CHANNEL1
+
+SPSC_RING(uartTxRing, uint8_t, UART_TX_RING)
+
+static uint8_t    rxRing[UART_RX_RING];
+static int        rxTail;             // Next byte to read
+static uartTxRing tx;                 // uartWrite() to the interrupt
+static uint32_t   errors;
+
+
+// uartInit
+//
+// The UART first, then the DMA channel waiting on its receive flag.
+// The transmit interrupt stays off until there's something to send.
+//
+void uartInit(int pbClk, uint32_t baud)
+{
+    UARTConfigure(UART2, UART_ENABLE_PINS_TX_RX_ONLY);
+    UARTSetFifoMode(UART2, UART_INTERRUPT_ON_TX_NOT_FULL | UART_INTERRUPT_ON_RX_NOT_EMPTY);
+    UARTSetLineControl(UART2, UART_DATA_SIZE_8_BITS | UART_PARITY_NONE | UART_STOP_BITS_1);
+    UARTSetDataRate(UART2, pbClk, baud);
+    UARTEnable(UART2, UART_ENABLE_FLAGS(UART_PERIPHERAL | UART_RX | UART_TX));
+
+    INTEnable(INT_U2TX, INT_DISABLED);
+    INTSetVectorPriority(INT_UART_2_VECTOR, INT_PRIORITY_LEVEL_1);
+    INTSetVectorSubPriority(INT_UART_2_VECTOR, INT_SUB_PRIORITY_LEVEL_0);
+
+    rxTail = 0;
+    tx.head = tx.tail = 0;
+    DmaChnOpen(UART_DMA, DMA_CHN_PRI2, DMA_OPEN_AUTO);
+    DmaChnSetEventControl(UART_DMA, DMA_EV_START_IRQ_EN | DMA_EV_START_IRQ(_UART2_RX_IRQ));
+    DmaChnSetTxfer(UART_DMA, (void *)&U2RXREG, rxRing, 1, UART_RX_RING, 1);
+    DmaChnEnable(UART_DMA);
+}
+
+
+// uartRead
+//
+// An overrun stops the receiver until it's cleared (losing what's in
+// the FIFO); the CRC sorts out the frame that was hit.
+//
+int uartRead(uint8_t *buf, int max)
+{
+    int head = DmaChnGetDstPnt(UART_DMA);
+    int n = 0;
+
+    if(U2STAbits.OERR)
+    {
+        errors++;
+        U2STAbits.OERR = 0;
+    }
+
+    while(rxTail != head && n < max)
+    {
+        buf[n++] = rxRing[rxTail];
+        if(++rxTail == UART_RX_RING)
+            rxTail = 0;
+    }
+    return n;
+}
+
+
+// uartWrite
+//
+// The interrupt only ever takes bytes off the ring, so the room checked
+// here can only grow before they're put on. If the interrupt runs
+// between the last put and turning it on, it sends them and turns
+// itself off, and the next run finds the ring empty.
+//
+int uartWrite(const uint8_t *buf, int n)
+{
+    int i;
+
+    if(n > UART_TX_RING - uartTxRingCount(&tx)) return 0;
+    for(i = 0; i < n; i++)
+        uartTxRingPut(&tx, &buf[i]);
+    INTEnable(INT_U2TX, INT_ENABLED);
+    return n;
+}
+
+
+uint32_t uartErrors(void)
+{
+    return errors;
+}
+
+
+// UART2 interrupt (transmit only; the receive flag starts the DMA): fill
+// the FIFO from the ring. The flag stays set while the FIFO has room, so
+// with the ring empty the interrupt has to turn itself off.
+//
+void __ISR(_UART_2_VECTOR, ipl1) uartInterrupt(void)
+{
+    CPU_IRQ_VAR(t0)
+    uint8_t b;
+
+    CPU_IRQ_ENTER(t0);
+    while(UARTTransmitterIsReady(UART2) && !uartTxRingGet(&tx, &b))
+        UARTSendDataByte(UART2, b);
+    if(!uartTxRingCount(&tx))
+        INTEnable(INT_U2TX, INT_DISABLED);
+    INTClearFlag(INT_U2TX);
+    CPU_IRQ_LEAVE(CPU_IRQ, t0);
+}